@@ -92,6 +92,7 @@ struct _J4statusPluginContext {
     J4statusI3barOutputClickEventsParseContext parse_context;
     gchar *header;
     gchar *line;
+    GString *escaped;
 };
 
 struct _J4statusOutputPluginStream {
@@ -457,6 +458,7 @@ _j4status_i3bar_output_init(J4statusCoreInterface *core)
     }
 
     context->json_handle = yajl_alloc(&_j4status_i3bar_output_click_events_callbacks, NULL, context);
+    context->escaped = g_string_new("");
 
     return context;
 }
@@ -464,11 +466,18 @@ _j4status_i3bar_output_init(J4statusCoreInterface *core)
 static void
 _j4status_i3bar_output_uninit(J4statusPluginContext *context)
 {
+    g_string_free(context->escaped, TRUE);
     yajl_free(context->json_handle);
 
     g_free(context->line);
     g_free(context->header);
 
+    g_free(context->colours.good);
+    g_free(context->colours.average);
+    g_free(context->colours.bad);
+    g_free(context->colours.unavailable);
+    g_free(context->colours.no_state);
+
     g_free(context);
 }
 
@@ -512,6 +521,22 @@ _j4status_i3bar_output_send_header(J4statusPluginContext *context, J4statusOutpu
     return g_data_output_stream_put_string(stream->out, context->header, NULL, error);
 }
 
+static void
+_j4status_i3bar_output_gen_string(J4statusPluginContext *context, yajl_gen json_gen, const gchar *string)
+{
+    /*
+     * Values can be long, so we escape them with our own kernel
+     * and hand the quoted result to yajl as a raw value.
+     * This is safe: j4status_escape_json_append() always produces
+     * a complete, valid JSON string, and yajl_gen_number() writes
+     * its argument verbatim while tracking it as a single value,
+     * so the map/array state and separators stay correct.
+     */
+    g_string_truncate(context->escaped, 0);
+    j4status_escape_json_append(context->escaped, string, -1);
+    yajl_gen_number(json_gen, context->escaped->str, context->escaped->len);
+}
+
 static void
 _j4status_i3bar_output_process_section(J4statusPluginContext *context, J4statusSection *section)
 {
@@ -553,7 +578,7 @@ _j4status_i3bar_output_process_section(J4statusPluginContext *context, J4statusS
         yajl_gen_string(json_gen, (const unsigned char *)label_colour, strlen("#000000"));
 
         yajl_gen_string(json_gen, (const unsigned char *)"full_text", strlen("full_text"));
-        yajl_gen_string(json_gen, (const unsigned char *)label_with_sep, strlen(label_with_sep));
+        _j4status_i3bar_output_gen_string(context, json_gen, label_with_sep);
 
         yajl_gen_string(json_gen, (const unsigned char *)"separator", strlen("separator"));
         yajl_gen_bool(json_gen, FALSE);
@@ -677,11 +702,11 @@ _j4status_i3bar_output_process_section(J4statusPluginContext *context, J4statusS
     if ( short_value != NULL )
     {
         yajl_gen_string(json_gen, (const unsigned char *)"short_text", strlen("short_text"));
-        yajl_gen_string(json_gen, (const unsigned char *)short_value, strlen(short_value));
+        _j4status_i3bar_output_gen_string(context, json_gen, short_value);
     }
 
     yajl_gen_string(json_gen, (const unsigned char *)"full_text", strlen("full_text"));
-    yajl_gen_string(json_gen, (const unsigned char *)value, strlen(value));
+    _j4status_i3bar_output_gen_string(context, json_gen, value);
     g_free(labelled_value);
 
     yajl_gen_map_close(json_gen);
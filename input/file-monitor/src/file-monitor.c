@@ -22,39 +22,375 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <errno.h>
 
 #include <glib.h>
 #include <gio/gio.h>
+#ifdef G_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef HAVE_INOTIFY
+#include <sys/inotify.h>
+#endif /* HAVE_INOTIFY */
+#include <glib-unix.h>
+#include <gio/gunixinputstream.h>
+#endif /* G_OS_UNIX */
 
 #include "j4status-plugin-input.h"
 
+#define DEFAULT_MAX_SIZE 4096
+/* Event bursts within that many milliseconds trigger a single read */
+#define DEBOUNCE_DELAY 50
+/* Buffer size for files with no meaningful size (procfs) */
+#define UNSIZED_READ_SIZE 4096
+
 struct _J4statusPluginContext {
     J4statusCoreInterface *core;
     GList *sections;
+    struct {
+        gsize max_size;
+        gboolean first_line;
+    } config;
+#ifdef HAVE_INOTIFY
+    struct {
+        gchar *dir;
+        gint fd;
+        guint id;
+        /* Basename to section, dispatches inotify events */
+        GHashTable *files;
+        /* Names handled by Files= and Streams= */
+        GHashTable *ignored;
+    } watch;
+#endif /* HAVE_INOTIFY */
 };
 
 typedef struct {
     J4statusPluginContext *context;
     GFileMonitor *monitor;
+    GBufferedInputStream *stream;
+    /* Dropping the rest of a line longer than MaxSize */
+    gboolean discard;
+    gchar *path;
     J4statusSection *section;
+    guint debounce_id;
+    GCancellable *cancellable;
+    gboolean reading;
+    gboolean pending;
+    gboolean has_hash;
+    guint64 hash;
 } J4statusFileMonitorSection;
 
+typedef struct {
+    gchar *path;
+    gsize max_size;
+    gboolean first_line;
+} J4statusFileMonitorReadData;
+
+typedef struct {
+    gchar *value;
+    guint64 hash;
+} J4statusFileMonitorContent;
+
 static void
-_j4status_file_monitor_changed(GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, gpointer user_data)
+_j4status_file_monitor_read_data_free(gpointer data)
 {
-    J4statusFileMonitorSection *section = user_data;
+    J4statusFileMonitorReadData *read_data = data;
+
+    g_free(read_data->path);
+
+    g_free(read_data);
+}
+
+static void
+_j4status_file_monitor_content_free(gpointer data)
+{
+    J4statusFileMonitorContent *content = data;
+
+    g_free(content->value);
+
+    g_free(content);
+}
+
+/* FNV-1a */
+static guint64
+_j4status_file_monitor_hash(const gchar *data, gsize length)
+{
+    guint64 hash = 14695981039346656037ULL;
+    gsize i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        hash ^= (guchar) data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Backs up so we never split a multibyte character */
+static gsize
+_j4status_file_monitor_utf8_cut(const gchar *data, gsize length)
+{
+    const gchar *end;
+    if ( g_utf8_validate(data, length, &end) )
+        return length;
+    if ( g_utf8_get_char_validated(end, data + length - end) == (gunichar) -2 )
+        return end - data;
+    return length;
+}
+
+static gsize
+_j4status_file_monitor_cut(const gchar *data, gsize length, gboolean first_line)
+{
+    if ( first_line )
+    {
+        const gchar *nl = memchr(data, '\n', length);
+        if ( nl != NULL )
+            return nl - data;
+    }
+    return _j4status_file_monitor_utf8_cut(data, length);
+}
+
+/*
+ * The file size is only a hint: we never allocate more than the file
+ * holds, and only grow the buffer for files with no size (procfs)
+ */
+static gsize
+_j4status_file_monitor_buffer_size(goffset size, gsize max_size)
+{
+    if ( size <= 0 )
+        return MIN(max_size, UNSIZED_READ_SIZE);
+    return MIN((guint64) size, max_size);
+}
 
+static gboolean
+_j4status_file_monitor_buffer_grow(gchar **data, gsize *allocated, gboolean sized, gsize max_size)
+{
+    if ( sized || ( *allocated >= max_size ) )
+        return FALSE;
+    *allocated = ( *allocated > max_size / 2 ) ? max_size : ( *allocated * 2 );
+    *data = g_realloc(*data, *allocated + 1);
+    return TRUE;
+}
+
+#ifdef G_OS_UNIX
+static gchar *
+_j4status_file_monitor_read_file(const gchar *path, gsize max_size, gboolean first_line, gsize *length, GError **error)
+{
+    gint fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if ( fd < 0 )
+    {
+        int errsv = errno;
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errsv), "Couldn't open '%s': %s", path, g_strerror(errsv));
+        return NULL;
+    }
+
+    struct stat st;
+    gboolean sized = ( fstat(fd, &st) == 0 ) && S_ISREG(st.st_mode) && ( st.st_size > 0 );
+    gsize allocated = _j4status_file_monitor_buffer_size(sized ? st.st_size : 0, max_size);
+    gchar *data = g_malloc(allocated + 1);
+
+    *length = 0;
+    while ( ( *length < allocated ) || _j4status_file_monitor_buffer_grow(&data, &allocated, sized, max_size) )
+    {
+        gssize r;
+        r = pread(fd, data + *length, allocated - *length, *length);
+        if ( ( r < 0 ) && ( errno == EINTR ) )
+            continue;
+        if ( r < 0 )
+        {
+            int errsv = errno;
+            g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errsv), "Couldn't read '%s': %s", path, g_strerror(errsv));
+            g_free(data);
+            data = NULL;
+            break;
+        }
+        if ( r == 0 )
+            break;
+        *length += r;
+        if ( first_line && ( memchr(data + *length - r, '\n', r) != NULL ) )
+            break;
+    }
+    close(fd);
+
+    return data;
+}
+#else /* ! G_OS_UNIX */
+static gchar *
+_j4status_file_monitor_read_file(const gchar *path, gsize max_size, gboolean first_line, gsize *length, GError **error)
+{
+    GFile *file;
     GFileInputStream *stream;
-    stream = g_file_read(file, NULL, NULL);
-    if ( stream != NULL )
+
+    file = g_file_new_for_path(path);
+    stream = g_file_read(file, NULL, error);
+    g_object_unref(file);
+    if ( stream == NULL )
+        return NULL;
+
+    GFileInfo *info;
+    goffset size = 0;
+    info = g_file_input_stream_query_info(stream, G_FILE_ATTRIBUTE_STANDARD_SIZE, NULL, NULL);
+    if ( info != NULL )
     {
-        GDataInputStream *data_stream;
-        data_stream = g_data_input_stream_new(G_INPUT_STREAM(stream));
-        g_object_unref(stream);
-        gsize length;
-        j4status_section_set_value(section->section, g_data_input_stream_read_upto(data_stream, "", -1, &length, NULL, NULL));
+        size = g_file_info_get_size(info);
+        g_object_unref(info);
+    }
+    gboolean sized = ( size > 0 );
+    gsize allocated = _j4status_file_monitor_buffer_size(size, max_size);
+    gchar *data = g_malloc(allocated + 1);
+
+    *length = 0;
+    while ( ( *length < allocated ) || _j4status_file_monitor_buffer_grow(&data, &allocated, sized, max_size) )
+    {
+        gssize r;
+        r = g_input_stream_read(G_INPUT_STREAM(stream), data + *length, allocated - *length, NULL, error);
+        if ( r < 0 )
+        {
+            g_free(data);
+            data = NULL;
+            break;
+        }
+        if ( r == 0 )
+            break;
+        *length += r;
+        if ( first_line && ( memchr(data + *length - r, '\n', r) != NULL ) )
+            break;
     }
+    g_object_unref(stream);
+
+    return data;
+}
+#endif /* ! G_OS_UNIX */
+
+static void
+_j4status_file_monitor_read_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    J4statusFileMonitorReadData *read_data = task_data;
+    GError *error = NULL;
+    gchar *data;
+    gsize length;
+
+    data = _j4status_file_monitor_read_file(read_data->path, read_data->max_size, read_data->first_line, &length, &error);
+    if ( data == NULL )
+    {
+        g_task_return_error(task, error);
+        return;
+    }
+
+    length = _j4status_file_monitor_cut(data, length, read_data->first_line);
+    data[length] = '\0';
+
+    J4statusFileMonitorContent *content;
+    content = g_new0(J4statusFileMonitorContent, 1);
+    content->value = data;
+    content->hash = _j4status_file_monitor_hash(data, length);
+    g_task_return_pointer(task, content, _j4status_file_monitor_content_free);
+}
+
+static void _j4status_file_monitor_read(J4statusFileMonitorSection *section);
+
+static void
+_j4status_file_monitor_read_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    J4statusFileMonitorContent *content;
+    GError *error = NULL;
+
+    content = g_task_propagate_pointer(G_TASK(res), &error);
+    if ( content == NULL )
+    {
+        /* The section is already gone */
+        if ( g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
+        {
+            g_error_free(error);
+            return;
+        }
+    }
+
+    J4statusFileMonitorSection *section = user_data;
+    section->reading = FALSE;
+
+    if ( content == NULL )
+    {
+        g_debug("%s", error->message);
+        g_error_free(error);
+    }
+    else if ( section->has_hash && ( section->hash == content->hash ) )
+        _j4status_file_monitor_content_free(content);
+    else
+    {
+        section->has_hash = TRUE;
+        section->hash = content->hash;
+        j4status_section_set_value(section->section, content->value);
+        content->value = NULL;
+        _j4status_file_monitor_content_free(content);
+    }
+
+    if ( section->pending )
+        _j4status_file_monitor_read(section);
+}
+
+static void
+_j4status_file_monitor_read(J4statusFileMonitorSection *section)
+{
+    if ( section->reading )
+    {
+        section->pending = TRUE;
+        return;
+    }
+    section->reading = TRUE;
+    section->pending = FALSE;
+
+    J4statusFileMonitorReadData *read_data;
+    read_data = g_new0(J4statusFileMonitorReadData, 1);
+    read_data->path = g_strdup(section->path);
+    read_data->max_size = section->context->config.max_size;
+    read_data->first_line = section->context->config.first_line;
+
+    GTask *task;
+    task = g_task_new(NULL, section->cancellable, _j4status_file_monitor_read_callback, section);
+    g_task_set_task_data(task, read_data, _j4status_file_monitor_read_data_free);
+    g_task_run_in_thread(task, _j4status_file_monitor_read_thread);
+    g_object_unref(task);
+}
+
+static gboolean
+_j4status_file_monitor_debounce(gpointer user_data)
+{
+    J4statusFileMonitorSection *section = user_data;
+
+    section->debounce_id = 0;
+    _j4status_file_monitor_read(section);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_j4status_file_monitor_schedule_read(J4statusFileMonitorSection *section)
+{
+    if ( section->debounce_id == 0 )
+        section->debounce_id = g_timeout_add(DEBOUNCE_DELAY, _j4status_file_monitor_debounce, section);
+}
+
+static void
+_j4status_file_monitor_changed(GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, gpointer user_data)
+{
+    J4statusFileMonitorSection *section = user_data;
+
+    if ( event_type == G_FILE_MONITOR_EVENT_DELETED )
+        return;
+
+    _j4status_file_monitor_schedule_read(section);
+}
+
+static void
+_j4status_file_monitor_stream_set_line(J4statusFileMonitorSection *section, const gchar *line, gsize length)
+{
+    length = MIN(length, section->context->config.max_size);
+    length = _j4status_file_monitor_utf8_cut(line, length);
+    j4status_section_set_value(section->section, ( length > 0 ) ? g_strndup(line, length) : NULL);
 }
 
 static void
@@ -62,13 +398,364 @@ _j4status_file_monitor_section_free(gpointer data)
 {
     J4statusFileMonitorSection *section = data;
 
+    if ( section->debounce_id > 0 )
+        g_source_remove(section->debounce_id);
+    g_cancellable_cancel(section->cancellable);
+    g_object_unref(section->cancellable);
+
     j4status_section_free(section->section);
 
-    g_object_unref(section->monitor);
+    if ( section->stream != NULL )
+        g_object_unref(section->stream);
+    if ( section->monitor != NULL )
+        g_object_unref(section->monitor);
+    g_free(section->path);
 
     g_free(section);
 }
 
+static J4statusFileMonitorSection *
+_j4status_file_monitor_section_new(J4statusPluginContext *context, const gchar *name)
+{
+    J4statusFileMonitorSection *section;
+    section = g_new0(J4statusFileMonitorSection, 1);
+    section->context = context;
+    section->cancellable = g_cancellable_new();
+    section->section = j4status_section_new(context->core);
+
+    j4status_section_set_name(section->section, "file-monitor");
+    j4status_section_set_instance(section->section, name);
+    j4status_section_set_label(section->section, name);
+
+    return section;
+}
+
+static void
+_j4status_file_monitor_add_file(J4statusPluginContext *context, const gchar *dir, const gchar *file)
+{
+    GError *error = NULL;
+    GFile *g_file;
+    GFileMonitor *monitor;
+
+    if ( g_path_is_absolute(file) )
+        g_file = g_file_new_for_path(file);
+    else
+    {
+        gchar *filename;
+        filename = g_build_filename(dir, file, NULL);
+
+        g_file = g_file_new_for_path(filename);
+        g_free(filename);
+    }
+    monitor = g_file_monitor_file(g_file, G_FILE_MONITOR_NONE, NULL, &error);
+    if ( monitor == NULL )
+    {
+        g_warning("Couldn't monitor file '%s': %s", file, error->message);
+        g_clear_error(&error);
+        g_object_unref(g_file);
+        return;
+    }
+
+    J4statusFileMonitorSection *section;
+    section = _j4status_file_monitor_section_new(context, file);
+    section->monitor = monitor;
+    section->path = g_file_get_path(g_file);
+    g_object_unref(g_file);
+
+    g_signal_connect(monitor, "changed", G_CALLBACK(_j4status_file_monitor_changed), section);
+
+    if ( j4status_section_insert(section->section) )
+        context->sections = g_list_prepend(context->sections, section);
+    else
+        _j4status_file_monitor_section_free(section);
+}
+
+#ifdef G_OS_UNIX
+static void _j4status_file_monitor_stream_fill(J4statusFileMonitorSection *section);
+
+/*
+ * The buffer holds MaxSize + 1 bytes, so a line is either complete
+ * in it or cut at MaxSize and the rest dropped up to the next newline
+ */
+static void
+_j4status_file_monitor_stream_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    GBufferedInputStream *stream = G_BUFFERED_INPUT_STREAM(source_object);
+    GError *error = NULL;
+    gssize r;
+
+    r = g_buffered_input_stream_fill_finish(stream, res, &error);
+    if ( r <= 0 )
+    {
+        /* Cancelled means the section is already gone */
+        if ( ( error != NULL ) && ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ) )
+            g_warning("Couldn't read from the pipe: %s", error->message);
+        g_clear_error(&error);
+        return;
+    }
+
+    J4statusFileMonitorSection *section = user_data;
+    gsize max_size = section->context->config.max_size;
+
+    const gchar *buffer;
+    gsize available;
+    while ( ( buffer = g_buffered_input_stream_peek_buffer(stream, &available) ), ( available > 0 ) )
+    {
+        const gchar *nl = memchr(buffer, '\n', available);
+        gsize skip;
+        if ( nl != NULL )
+        {
+            if ( ! section->discard )
+                _j4status_file_monitor_stream_set_line(section, buffer, nl - buffer);
+            section->discard = FALSE;
+            skip = nl - buffer + 1;
+        }
+        else if ( available >= max_size )
+        {
+            if ( ! section->discard )
+                _j4status_file_monitor_stream_set_line(section, buffer, available);
+            section->discard = TRUE;
+            skip = available;
+        }
+        else
+            break;
+
+        /* Only consumes what is already buffered, never blocks */
+        g_input_stream_skip(G_INPUT_STREAM(stream), skip, NULL, NULL);
+    }
+
+    _j4status_file_monitor_stream_fill(section);
+}
+
+static void
+_j4status_file_monitor_stream_fill(J4statusFileMonitorSection *section)
+{
+    g_buffered_input_stream_fill_async(section->stream, -1, G_PRIORITY_DEFAULT, section->cancellable, _j4status_file_monitor_stream_callback, section);
+}
+
+static void
+_j4status_file_monitor_add_stream(J4statusPluginContext *context, const gchar *dir, const gchar *name)
+{
+    gchar *path;
+    path = g_build_filename(dir, name, NULL);
+
+    struct stat st;
+    if ( ( stat(path, &st) < 0 ) && ( ( errno != ENOENT ) || ( mkfifo(path, 0600) < 0 ) ) )
+    {
+        g_warning("Couldn't create the pipe '%s': %s", path, g_strerror(errno));
+        goto fail;
+    }
+    if ( ( stat(path, &st) == 0 ) && ( ! S_ISFIFO(st.st_mode) ) )
+    {
+        g_warning("'%s' exists and is not a pipe", path);
+        goto fail;
+    }
+
+    /*
+     * Opening read-write keeps a writer around, so we never see EOF
+     * when scripts close their end
+     */
+    gint fd;
+    fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if ( fd < 0 )
+    {
+        g_warning("Couldn't open the pipe '%s': %s", path, g_strerror(errno));
+        goto fail;
+    }
+
+    GInputStream *stream;
+    stream = g_unix_input_stream_new(fd, TRUE);
+
+    J4statusFileMonitorSection *section;
+    section = _j4status_file_monitor_section_new(context, name);
+    section->path = path;
+    section->stream = G_BUFFERED_INPUT_STREAM(g_buffered_input_stream_new_sized(stream, context->config.max_size + 1));
+    g_object_unref(stream);
+
+    if ( ! j4status_section_insert(section->section) )
+    {
+        _j4status_file_monitor_section_free(section);
+        return;
+    }
+
+    context->sections = g_list_prepend(context->sections, section);
+    _j4status_file_monitor_stream_fill(section);
+    return;
+
+fail:
+    g_free(path);
+}
+#endif /* G_OS_UNIX */
+
+#ifdef HAVE_INOTIFY
+static void
+_j4status_file_monitor_watch_add(J4statusPluginContext *context, const gchar *name)
+{
+    /* Skip hidden files, editors and scripts use them as temporary files */
+    if ( ( name[0] == '.' ) || g_hash_table_contains(context->watch.ignored, name) || g_hash_table_contains(context->watch.files, name) )
+        return;
+
+    gchar *path;
+    path = g_build_filename(context->watch.dir, name, NULL);
+
+    struct stat st;
+    if ( ( stat(path, &st) < 0 ) || ( ! S_ISREG(st.st_mode) ) )
+    {
+        g_free(path);
+        return;
+    }
+
+    J4statusFileMonitorSection *section;
+    section = _j4status_file_monitor_section_new(context, name);
+    section->path = path;
+
+    if ( ! j4status_section_insert(section->section) )
+    {
+        _j4status_file_monitor_section_free(section);
+        return;
+    }
+
+    g_hash_table_insert(context->watch.files, g_strdup(name), section);
+    _j4status_file_monitor_schedule_read(section);
+}
+
+static void
+_j4status_file_monitor_watch_scan(J4statusPluginContext *context)
+{
+    GHashTableIter iter;
+    gpointer section;
+
+    g_hash_table_iter_init(&iter, context->watch.files);
+    while ( g_hash_table_iter_next(&iter, NULL, &section) )
+    {
+        if ( access(((J4statusFileMonitorSection *) section)->path, F_OK) < 0 )
+            g_hash_table_iter_remove(&iter);
+        else
+            _j4status_file_monitor_schedule_read(section);
+    }
+
+    GDir *dir;
+    dir = g_dir_open(context->watch.dir, 0, NULL);
+    if ( dir == NULL )
+        return;
+
+    const gchar *name;
+    while ( ( name = g_dir_read_name(dir) ) != NULL )
+        _j4status_file_monitor_watch_add(context, name);
+    g_dir_close(dir);
+}
+
+static void
+_j4status_file_monitor_watch_event(J4statusPluginContext *context, const struct inotify_event *event)
+{
+    if ( event->mask & IN_Q_OVERFLOW )
+    {
+        /* We lost events, re-sync with the directory content */
+        _j4status_file_monitor_watch_scan(context);
+        return;
+    }
+    if ( event->mask & IN_IGNORED )
+    {
+        g_warning("Directory '%s' is not watched anymore", context->watch.dir);
+        return;
+    }
+    if ( ( event->len == 0 ) || ( event->mask & IN_ISDIR ) )
+        return;
+
+    if ( event->mask & ( IN_DELETE | IN_MOVED_FROM ) )
+    {
+        g_hash_table_remove(context->watch.files, event->name);
+        return;
+    }
+
+    J4statusFileMonitorSection *section;
+    section = g_hash_table_lookup(context->watch.files, event->name);
+    if ( section == NULL )
+        _j4status_file_monitor_watch_add(context, event->name);
+    else
+        _j4status_file_monitor_schedule_read(section);
+}
+
+static gboolean
+_j4status_file_monitor_watch_callback(gint fd, GIOCondition condition, gpointer user_data)
+{
+    J4statusPluginContext *context = user_data;
+    gchar buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    gssize r;
+
+    while ( ( r = read(fd, buffer, sizeof(buffer)) ) > 0 )
+    {
+        const struct inotify_event *event;
+        gchar *p;
+        for ( p = buffer ; p < buffer + r ; p += sizeof(struct inotify_event) + event->len )
+        {
+            event = (const struct inotify_event *) p;
+            _j4status_file_monitor_watch_event(context, event);
+        }
+    }
+
+    if ( ( r < 0 ) && ( errno != EAGAIN ) && ( errno != EINTR ) )
+    {
+        g_warning("Couldn't read inotify events: %s", g_strerror(errno));
+        context->watch.id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+_j4status_file_monitor_watch_init(J4statusPluginContext *context, const gchar *dir, gchar **files, gchar **streams)
+{
+    context->watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ( context->watch.fd < 0 )
+    {
+        g_warning("Couldn't initialize inotify: %s", g_strerror(errno));
+        return FALSE;
+    }
+
+    if ( inotify_add_watch(context->watch.fd, dir, IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_ONLYDIR) < 0 )
+    {
+        g_warning("Couldn't watch directory '%s': %s", dir, g_strerror(errno));
+        close(context->watch.fd);
+        context->watch.fd = -1;
+        return FALSE;
+    }
+
+    context->watch.dir = g_strdup(dir);
+    context->watch.files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _j4status_file_monitor_section_free);
+    context->watch.ignored = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    gchar **file;
+    for ( file = files ; ( file != NULL ) && ( *file != NULL ) ; ++file )
+        g_hash_table_add(context->watch.ignored, g_strdup(*file));
+    for ( file = streams ; ( file != NULL ) && ( *file != NULL ) ; ++file )
+        g_hash_table_add(context->watch.ignored, g_strdup(*file));
+
+    context->watch.id = g_unix_fd_add(context->watch.fd, G_IO_IN, _j4status_file_monitor_watch_callback, context);
+
+    _j4status_file_monitor_watch_scan(context);
+
+    return TRUE;
+}
+
+static void
+_j4status_file_monitor_watch_uninit(J4statusPluginContext *context)
+{
+    if ( context->watch.id > 0 )
+        g_source_remove(context->watch.id);
+    if ( context->watch.files != NULL )
+        g_hash_table_unref(context->watch.files);
+    if ( context->watch.ignored != NULL )
+        g_hash_table_unref(context->watch.ignored);
+    if ( context->watch.fd >= 0 )
+        close(context->watch.fd);
+    g_free(context->watch.dir);
+}
+#endif /* HAVE_INOTIFY */
+
+static void _j4status_file_monitor_uninit(J4statusPluginContext *context);
+
 static J4statusPluginContext *
 _j4status_file_monitor_init(J4statusCoreInterface *core)
 {
@@ -89,68 +776,65 @@ _j4status_file_monitor_init(J4statusCoreInterface *core)
     }
 
     gchar **files;
+    gchar **streams;
     files = g_key_file_get_string_list(key_file, "FileMonitor", "Files", NULL, NULL);
-    if ( files == NULL )
+    streams = g_key_file_get_string_list(key_file, "FileMonitor", "Streams", NULL, NULL);
+    gboolean watch_directory = g_key_file_get_boolean(key_file, "FileMonitor", "WatchDirectory", NULL);
+#ifndef G_OS_UNIX
+    if ( streams != NULL )
+        g_warning("Streams are not supported on this platform");
+    g_strfreev(streams);
+    streams = NULL;
+#endif /* ! G_OS_UNIX */
+#ifndef HAVE_INOTIFY
+    if ( watch_directory )
+        g_warning("Directory watch is not supported on this platform");
+    watch_directory = FALSE;
+#endif /* ! HAVE_INOTIFY */
+    if ( ( files == NULL ) && ( streams == NULL ) && ( ! watch_directory ) )
     {
         g_message("Missing configuration: Empty list of files to monitor, aborting");
         goto fail;
     }
 
+    guint64 max_size = g_key_file_get_uint64(key_file, "FileMonitor", "MaxSize", NULL);
+    gboolean first_line = g_key_file_get_boolean(key_file, "FileMonitor", "FirstLine", NULL);
+
     g_key_file_free(key_file);
 
     J4statusPluginContext *context;
     context = g_new0(J4statusPluginContext, 1);
     context->core = core;
+    context->config.max_size = ( max_size > 0 ) ? MIN(max_size, G_MAXSIZE - 1) : DEFAULT_MAX_SIZE;
+    context->config.first_line = first_line;
+#ifdef HAVE_INOTIFY
+    context->watch.fd = -1;
+#endif /* HAVE_INOTIFY */
 
     gchar **file;
-    for ( file = files ; *file != NULL ; ++file )
+    if ( files != NULL )
     {
-        GError *error = NULL;
-        GFile *g_file;
-        GFileMonitor *monitor;
-
-        if ( g_path_is_absolute(*file) )
-            g_file = g_file_new_for_path(*file);
-        else
-        {
-            gchar *filename;
-            filename = g_build_filename(dir, *file, NULL);
-
-            g_file = g_file_new_for_path(filename);
-            g_free(filename);
-        }
-        monitor = g_file_monitor_file(g_file, G_FILE_MONITOR_NONE, NULL, &error);
-        g_object_unref(g_file);
-        if ( monitor == NULL )
-        {
-            g_warning("Couldn't monitor file '%s': %s", *file, error->message);
-            g_clear_error(&error);
-            continue;
-        }
-
-        J4statusFileMonitorSection *section;
-        section = g_new0(J4statusFileMonitorSection, 1);
-        section->context = context;
-        section->monitor = monitor;
-        section->section = j4status_section_new(context->core);
-
-        j4status_section_set_name(section->section, "file-monitor");
-        j4status_section_set_instance(section->section, *file);
-        j4status_section_set_label(section->section, *file);
-        g_signal_connect(monitor, "changed", G_CALLBACK(_j4status_file_monitor_changed), section);
-
-        if ( j4status_section_insert(section->section) )
-            context->sections = g_list_prepend(context->sections, section);
-        else
-            _j4status_file_monitor_section_free(section);
+        for ( file = files ; *file != NULL ; ++file )
+            _j4status_file_monitor_add_file(context, dir, *file);
+    }
+#ifdef G_OS_UNIX
+    if ( streams != NULL )
+    {
+        for ( file = streams ; *file != NULL ; ++file )
+            _j4status_file_monitor_add_stream(context, dir, *file);
     }
+#endif /* G_OS_UNIX */
+#ifdef HAVE_INOTIFY
+    if ( watch_directory && ( ! _j4status_file_monitor_watch_init(context, dir, files, streams) ) )
+        watch_directory = FALSE;
+#endif /* HAVE_INOTIFY */
+    g_strfreev(streams);
     g_strfreev(files);
     g_free(dir);
 
-    if ( context->sections == NULL )
+    if ( ( context->sections == NULL ) && ( ! watch_directory ) )
     {
-        g_free(context);
-        g_free(dir);
+        _j4status_file_monitor_uninit(context);
         return NULL;
     }
 
@@ -166,6 +850,9 @@ fail:
 static void
 _j4status_file_monitor_uninit(J4statusPluginContext *context)
 {
+#ifdef HAVE_INOTIFY
+    _j4status_file_monitor_watch_uninit(context);
+#endif /* HAVE_INOTIFY */
     g_list_free_full(context->sections, _j4status_file_monitor_section_free);
 
     g_free(context);
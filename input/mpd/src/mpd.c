@@ -77,6 +77,34 @@ typedef enum {
     STATE_STOP,
 } J4statusMpdSectionState;
 
+typedef enum {
+    SUBSYSTEM_PLAYER   = (1 << 0),
+    SUBSYSTEM_DATABASE = (1 << 1),
+    SUBSYSTEM_OPTIONS  = (1 << 2),
+    SUBSYSTEM_MIXER    = (1 << 3),
+    /* Initial or after an action: full query, always rendered */
+    SUBSYSTEM_FULL     = (1 << 4),
+} J4statusMpdSubsystem;
+
+static const gchar * const _j4status_mpd_subsystems[] = {
+    "player",
+    "database",
+    "options",
+    "mixer",
+};
+
+/* Everything parsed from status, compared to skip useless renders */
+typedef struct {
+    J4statusMpdSectionState state;
+    gboolean updating;
+    gboolean repeat;
+    gboolean random;
+    gboolean single;
+    gboolean consume;
+    gint8 volume;
+    gint64 duration;
+} J4statusMpdStatus;
+
 typedef struct {
     J4statusPluginContext *context;
     J4statusSection *section;
@@ -89,14 +117,15 @@ typedef struct {
     J4statusMpdCommand command;
     J4statusMpdAction pending;
 
+    J4statusMpdSubsystem changed;
+    J4statusMpdStatus previous;
+    gchar *previous_song;
+
     gchar *current_song;
-    J4statusMpdSectionState state;
-    gboolean updating;
-    gboolean repeat;
-    gboolean random;
-    gboolean single;
-    gboolean consume;
-    gint8 volume;
+    J4statusMpdStatus status;
+    gint64 elapsed;
+    gint64 elapsed_time;
+    guint tick_id;
 } J4statusMpdSection;
 
 typedef enum {
@@ -105,6 +134,9 @@ typedef enum {
     TOKEN_DATABASE,
     TOKEN_OPTIONS,
     TOKEN_VOLUME,
+    TOKEN_ELAPSED,
+    TOKEN_DURATION,
+    TOKEN_PROGRESS,
 } J4statusMpdFormatToken;
 
 typedef enum {
@@ -113,14 +145,23 @@ typedef enum {
     TOKEN_FLAG_DATABASE = (1 << TOKEN_DATABASE),
     TOKEN_FLAG_OPTIONS  = (1 << TOKEN_OPTIONS),
     TOKEN_FLAG_VOLUME   = (1 << TOKEN_VOLUME),
+    TOKEN_FLAG_ELAPSED  = (1 << TOKEN_ELAPSED),
+    TOKEN_FLAG_DURATION = (1 << TOKEN_DURATION),
+    TOKEN_FLAG_PROGRESS = (1 << TOKEN_PROGRESS),
 } J4statusMpdFormatTokenFlag;
 
+#define TOKEN_FLAGS_PLAYER (TOKEN_FLAG_STATE | TOKEN_FLAG_SONG | TOKEN_FLAG_ELAPSED | TOKEN_FLAG_DURATION | TOKEN_FLAG_PROGRESS)
+#define TOKEN_FLAGS_TICK (TOKEN_FLAG_ELAPSED | TOKEN_FLAG_PROGRESS)
+
 static const gchar * const _j4status_mpd_format_tokens[] = {
     [TOKEN_SONG]     = "song",
     [TOKEN_STATE]    = "state",
     [TOKEN_DATABASE] = "database",
     [TOKEN_OPTIONS]  = "options",
     [TOKEN_VOLUME]   = "volume",
+    [TOKEN_ELAPSED]  = "elapsed",
+    [TOKEN_DURATION] = "duration",
+    [TOKEN_PROGRESS] = "progress",
 };
 
 #define J4STATUS_MPD_DEFAULT_FORMAT "${song:-No song}${database:+ ↻} [${options[repeat]:{;r; }}${options[random]:{;z; }}${options[single]:{;1; }}${options[consume]:{;-; }}]"
@@ -146,7 +187,7 @@ _j4status_mpd_section_command(J4statusMpdSection *section, J4statusMpdCommand co
     {
         const gchar *params[4] = {NULL};
         gsize n = 0;
-        if ( section->used_tokens & (TOKEN_FLAG_STATE | TOKEN_FLAG_SONG) )
+        if ( section->used_tokens & TOKEN_FLAGS_PLAYER )
             params[n++] = "player";
         if ( section->used_tokens & TOKEN_FLAG_DATABASE )
             params[n++] = "database";
@@ -158,10 +199,26 @@ _j4status_mpd_section_command(J4statusMpdSection *section, J4statusMpdCommand co
     }
     break;
     case COMMAND_QUERY:
-        mpd_async_send_command(section->mpd, "command_list_begin", NULL);
-        mpd_async_send_command(section->mpd, "status", NULL);
-        mpd_async_send_command(section->mpd, "currentsong", NULL);
-        mpd_async_send_command(section->mpd, "command_list_end", NULL);
+        section->previous = section->status;
+        /* MPD omits these when not true or stopped */
+        section->status.updating = FALSE;
+        section->elapsed = -1;
+        section->status.duration = -1;
+
+        /* The song can only change with the player */
+        if ( section->changed & ( SUBSYSTEM_PLAYER | SUBSYSTEM_FULL ) )
+        {
+            g_free(section->previous_song);
+            section->previous_song = section->current_song;
+            section->current_song = NULL;
+
+            mpd_async_send_command(section->mpd, "command_list_begin", NULL);
+            mpd_async_send_command(section->mpd, "status", NULL);
+            mpd_async_send_command(section->mpd, "currentsong", NULL);
+            mpd_async_send_command(section->mpd, "command_list_end", NULL);
+        }
+        else
+            mpd_async_send_command(section->mpd, "status", NULL);
     break;
     case COMMAND_ACTION:
     {
@@ -174,7 +231,7 @@ _j4status_mpd_section_command(J4statusMpdSection *section, J4statusMpdCommand co
         break;
         case ACTION_TOGGLE:
             command_str = "pause";
-            params[0] = ( section->state == STATE_PAUSE ) ? "0" : "1";
+            params[0] = ( section->status.state == STATE_PAUSE ) ? "0" : "1";
         break;
         case ACTION_PLAY:
             command_str = "play";
@@ -225,6 +282,24 @@ _j4status_mpd_section_action_callback(J4statusSection *section_, const gchar *ev
     section->pending = GPOINTER_TO_UINT(g_hash_table_lookup(section->context->config.actions, event_id));
 }
 
+/*
+ * Interpolated from the last status answer, MPD is only queried again
+ * on player events
+ */
+static gint64
+_j4status_mpd_section_get_elapsed(const J4statusMpdSection *section)
+{
+    if ( section->elapsed < 0 )
+        return -1;
+
+    gint64 elapsed = section->elapsed;
+    if ( section->status.state == STATE_PLAY )
+        elapsed += g_get_monotonic_time() - section->elapsed_time;
+    if ( section->status.duration > 0 )
+        elapsed = MIN(elapsed, section->status.duration);
+    return elapsed;
+}
+
 GVariant *
 _j4status_mpd_format_callback(const gchar *token, guint64 value, gconstpointer user_data)
 {
@@ -236,38 +311,77 @@ _j4status_mpd_format_callback(const gchar *token, guint64 value, gconstpointer u
             return NULL;
         return g_variant_new_string(section->current_song);
     case TOKEN_STATE:
-        return g_variant_new_byte(section->state);
+        return g_variant_new_byte(section->status.state);
     break;
     case TOKEN_DATABASE:
-        return g_variant_new_boolean(section->updating);
+        return g_variant_new_boolean(section->status.updating);
     case TOKEN_OPTIONS:
     {
         GVariantDict options;
         g_variant_dict_init(&options, NULL);
-        g_variant_dict_insert_value(&options, "repeat", g_variant_new_boolean(section->repeat));
-        g_variant_dict_insert_value(&options, "random", g_variant_new_boolean(section->random));
-        g_variant_dict_insert_value(&options, "single", g_variant_new_boolean(section->single));
-        g_variant_dict_insert_value(&options, "consume", g_variant_new_boolean(section->consume));
+        g_variant_dict_insert_value(&options, "repeat", g_variant_new_boolean(section->status.repeat));
+        g_variant_dict_insert_value(&options, "random", g_variant_new_boolean(section->status.random));
+        g_variant_dict_insert_value(&options, "single", g_variant_new_boolean(section->status.single));
+        g_variant_dict_insert_value(&options, "consume", g_variant_new_boolean(section->status.consume));
         return g_variant_dict_end(&options);
 
     }
     case TOKEN_VOLUME:
-        if ( section->volume < 0 )
+        if ( section->status.volume < 0 )
+            return NULL;
+        return g_variant_new_int16(section->status.volume);
+    case TOKEN_ELAPSED:
+    {
+        gint64 elapsed = _j4status_mpd_section_get_elapsed(section);
+        if ( elapsed < 0 )
             return NULL;
-        return g_variant_new_int16(section->volume);
+        return g_variant_new_int64(elapsed / G_USEC_PER_SEC);
+    }
+    case TOKEN_DURATION:
+        if ( section->status.duration < 0 )
+            return NULL;
+        return g_variant_new_int64(section->status.duration / G_USEC_PER_SEC);
+    case TOKEN_PROGRESS:
+    {
+        gint64 elapsed = _j4status_mpd_section_get_elapsed(section);
+        if ( ( elapsed < 0 ) || ( section->status.duration <= 0 ) )
+            return NULL;
+        return g_variant_new_double((gdouble) elapsed * 100. / (gdouble) section->status.duration);
+    }
     default:
         g_return_val_if_reached(NULL);
     }
     return NULL;
 }
 
+static gboolean _j4status_mpd_section_tick(gpointer user_data);
+
+static void
+_j4status_mpd_section_schedule(J4statusMpdSection *section)
+{
+    if ( section->tick_id > 0 )
+        g_source_remove(section->tick_id);
+    section->tick_id = 0;
+
+    if ( ( ! section->context->started ) || ( section->status.state != STATE_PLAY ) || ( ( section->used_tokens & TOKEN_FLAGS_TICK ) == 0 ) )
+        return;
+
+    gint64 elapsed = _j4status_mpd_section_get_elapsed(section);
+    if ( elapsed < 0 )
+        return;
+
+    /* Wake up just after the next second of the song */
+    guint delay = ( G_USEC_PER_SEC - elapsed % G_USEC_PER_SEC ) / 1000 + 1;
+    section->tick_id = g_timeout_add(delay, _j4status_mpd_section_tick, section);
+}
+
 static void
 _j4status_mpd_section_update(J4statusMpdSection *section)
 {
     J4statusState state = J4STATUS_STATE_NO_STATE;
     gchar *value;
 
-    switch ( section->state )
+    switch ( section->status.state )
     {
     case STATE_PLAY:
         state = J4STATUS_STATE_GOOD;
@@ -284,6 +398,60 @@ _j4status_mpd_section_update(J4statusMpdSection *section)
 
     j4status_section_set_state(section->section, state);
     j4status_section_set_value(section->section, value);
+
+    _j4status_mpd_section_schedule(section);
+}
+
+static gboolean
+_j4status_mpd_section_tick(gpointer user_data)
+{
+    J4statusMpdSection *section = user_data;
+
+    section->tick_id = 0;
+    /* A running query will update on its own */
+    if ( section->command != COMMAND_QUERY )
+        _j4status_mpd_section_update(section);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+_j4status_mpd_status_equal(const J4statusMpdStatus *a, const J4statusMpdStatus *b)
+{
+    return ( a->state == b->state )
+        && ( a->updating == b->updating )
+        && ( a->repeat == b->repeat )
+        && ( a->random == b->random )
+        && ( a->single == b->single )
+        && ( a->consume == b->consume )
+        && ( a->volume == b->volume )
+        && ( a->duration == b->duration );
+}
+
+static void
+_j4status_mpd_section_query_done(J4statusMpdSection *section)
+{
+    gboolean render = ( section->changed & SUBSYSTEM_FULL );
+
+    if ( section->changed & ( SUBSYSTEM_PLAYER | SUBSYSTEM_FULL ) )
+    {
+        if ( g_strcmp0(section->previous_song, section->current_song) != 0 )
+            render = TRUE;
+        /* A seek only shows in elapsed */
+        if ( section->used_tokens & TOKEN_FLAGS_TICK )
+            render = TRUE;
+        g_free(section->previous_song);
+        section->previous_song = NULL;
+    }
+    if ( ! _j4status_mpd_status_equal(&section->previous, &section->status) )
+        render = TRUE;
+
+    section->changed = 0;
+
+    if ( render )
+        _j4status_mpd_section_update(section);
+    else
+        _j4status_mpd_section_schedule(section);
 }
 
 static void _j4status_mpd_section_free(gpointer data);
@@ -310,12 +478,11 @@ _j4status_mpd_section_line_callback(gchar *line, enum mpd_error error, gpointer
         if ( g_str_has_prefix(line, "changed: ") )
         {
             const gchar *subsystem = line + strlen("changed: ");
-            if ( g_strcmp0(subsystem, "database") == 0 )
-                section->updating = FALSE;
-            if ( g_strcmp0(subsystem, "player") == 0 )
+            gsize i;
+            for ( i = 0 ; i < G_N_ELEMENTS(_j4status_mpd_subsystems) ; ++i )
             {
-                g_free(section->current_song);
-                section->current_song = NULL;
+                if ( g_strcmp0(subsystem, _j4status_mpd_subsystems[i]) == 0 )
+                    section->changed |= ( 1 << i );
             }
             break;
         }
@@ -325,7 +492,7 @@ _j4status_mpd_section_line_callback(gchar *line, enum mpd_error error, gpointer
     case COMMAND_QUERY:
         if ( g_strcmp0(line, "OK") == 0 )
         {
-            _j4status_mpd_section_update(section);
+            _j4status_mpd_section_query_done(section);
             _j4status_mpd_section_command(section, COMMAND_IDLE);
             break;
         }
@@ -333,14 +500,14 @@ _j4status_mpd_section_line_callback(gchar *line, enum mpd_error error, gpointer
         {
             const gchar *state = line + strlen("state: ");
             if ( g_strcmp0(state, "play") == 0 )
-                section->state = STATE_PLAY;
+                section->status.state = STATE_PLAY;
             else if ( g_strcmp0(state, "pause") == 0 )
-                section->state = STATE_PAUSE;
+                section->status.state = STATE_PAUSE;
             else if ( g_strcmp0(state, "stop") == 0 )
-                section->state = STATE_STOP;
+                section->status.state = STATE_STOP;
         }
         else if ( g_str_has_prefix(line, "updating_db: ") )
-            section->updating = TRUE;
+            section->status.updating = TRUE;
         else if ( g_ascii_strncasecmp(line, "file: ", strlen("file: ")) == 0 )
         {
             if ( section->current_song == NULL )
@@ -359,24 +526,32 @@ _j4status_mpd_section_line_callback(gchar *line, enum mpd_error error, gpointer
             section->current_song = g_strdup(line + strlen("Title: "));
         }
         else if ( g_str_has_prefix(line, "repeat: ") )
-            section->repeat = ( line[strlen("repeat: ")] == '1');
+            section->status.repeat = ( line[strlen("repeat: ")] == '1');
         else if ( g_str_has_prefix(line, "random: ") )
-            section->random = ( line[strlen("random: ")] == '1');
+            section->status.random = ( line[strlen("random: ")] == '1');
         else if ( g_str_has_prefix(line, "single: ") )
-            section->single = ( line[strlen("single: ")] == '1');
+            section->status.single = ( line[strlen("single: ")] == '1');
         else if ( g_str_has_prefix(line, "consume: ") )
-            section->consume = ( line[strlen("consume: ")] == '1');
+            section->status.consume = ( line[strlen("consume: ")] == '1');
+        else if ( g_str_has_prefix(line, "elapsed: ") )
+        {
+            section->elapsed = g_ascii_strtod(line + strlen("elapsed: "), NULL) * G_USEC_PER_SEC;
+            section->elapsed_time = g_get_monotonic_time();
+        }
+        else if ( g_str_has_prefix(line, "duration: ") )
+            section->status.duration = g_ascii_strtod(line + strlen("duration: "), NULL) * G_USEC_PER_SEC;
         else if ( g_str_has_prefix(line, "volume: ") )
         {
             gint64 tmp;
             tmp = g_ascii_strtoll(line + strlen("volume: "), NULL, 100);
-            section->volume = CLAMP(tmp, -1, 100);
+            section->status.volume = CLAMP(tmp, -1, 100);
         }
     break;
     case COMMAND_ACTION:
         if ( g_strcmp0(line, "OK") == 0 )
         {
             section->pending = ACTION_NONE;
+            section->changed = SUBSYSTEM_FULL;
             _j4status_mpd_section_command(section, COMMAND_QUERY);
         }
     break;
@@ -403,10 +578,16 @@ _j4status_mpd_section_free(gpointer data)
 {
     J4statusMpdSection *section = data;
 
+    if ( section->tick_id > 0 )
+        g_source_remove(section->tick_id);
+
     j4status_section_free(section->section);
 
     g_water_mpd_source_free(section->source);
 
+    g_free(section->previous_song);
+    g_free(section->current_song);
+
     g_free(section);
 }
 
@@ -419,6 +600,7 @@ _j4status_mpd_section_new(J4statusPluginContext *context, const gchar *host, gui
     section = g_new0(J4statusMpdSection, 1);
     section->context = context;
     section->pending = ACTION_NONE;
+    section->changed = SUBSYSTEM_FULL;
 
     section->source = g_water_mpd_source_new(NULL, host, port, _j4status_mpd_section_line_callback, section, NULL, &error);
     if ( section->source == NULL )
@@ -444,7 +626,9 @@ _j4status_mpd_section_new(J4statusPluginContext *context, const gchar *host, gui
         return NULL;
     }
 
-    section->volume = -1;
+    section->status.volume = -1;
+    section->elapsed = -1;
+    section->status.duration = -1;
 
     gchar group_name[strlen("MPD ") + strlen(host) + 1];
     g_sprintf(group_name, "MPD %s", host);
@@ -572,10 +756,20 @@ _j4status_mpd_start(J4statusPluginContext *context)
     g_list_foreach(context->sections, _j4status_mpd_section_start, context);
 }
 
+static void
+_j4status_mpd_section_stop(gpointer data, gpointer user_data)
+{
+    J4statusMpdSection *section = data;
+    if ( section->tick_id > 0 )
+        g_source_remove(section->tick_id);
+    section->tick_id = 0;
+}
+
 static void
 _j4status_mpd_stop(J4statusPluginContext *context)
 {
     context->started = FALSE;
+    g_list_foreach(context->sections, _j4status_mpd_section_stop, context);
 }
 
 J4STATUS_EXPORT void
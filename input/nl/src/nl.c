@@ -29,6 +29,7 @@
 
 #include <sys/socket.h>
 #include <linux/if_arp.h>
+#include <linux/if_ether.h>
 #include <linux/netlink.h>
 #include <linux/nl80211.h>
 #include <netlink/netlink.h>
@@ -121,12 +122,11 @@ typedef enum {
 #define J4STATUS_NL_DEFAULT_FORMAT_UP_WIFI "${addresses} (${strength}${strength:+% }${ssid/^.+$/at \\0, }${bitrate:+${bitrate(p)}b/s})"
 #define J4STATUS_NL_DEFAULT_FORMAT_DOWN_WIFI "Down${aps/^.+$/(\\0 APs)}"
 
-typedef struct {
-    int error;
-    struct nlattr **answer;
-    int size;
-    gsize number;
-} J4statusNlMessageAnswer;
+typedef enum {
+    REQUEST_INTERFACE,
+    REQUEST_SCAN,
+    REQUEST_STATION,
+} J4statusNlRequestType;
 
 struct _J4statusPluginContext {
     GHashTable *sections;
@@ -136,10 +136,17 @@ struct _J4statusPluginContext {
     struct nl_cache *link_cache;
     struct nl_cache *addr_cache;
     struct {
-        J4statusNlMessageAnswer data;
         GWaterNlSource *source;
         struct nl_sock *sock;
         int id;
+        /* In flight requests, by sequence number */
+        GHashTable *requests;
+        /*
+         * The kernel runs only one dump per socket at a time,
+         * sections wait here for their scan dump
+         */
+        GQueue scans;
+        gboolean dumping;
         GWaterNlSource *esource;
         struct nl_sock *esock;
     } nl80211;
@@ -157,6 +164,14 @@ struct _J4statusPluginContext {
     } formats;
 };
 
+typedef struct {
+    gboolean has_ap;
+    gchar *ssid;
+    gint8 strength;
+    guint64 bitrate;
+    gint64 aps;
+} J4statusNlWifiInfo;
+
 typedef struct {
     J4statusPluginContext *context;
     J4statusSection *section;
@@ -164,12 +179,19 @@ typedef struct {
     struct rtnl_link *link;
     struct {
         gboolean is;
-        gboolean has_ap;
-        gchar *ssid;
-        gint8 strength;
-        guint64 bitrate;
-        gint64 aps;
+        gboolean checking;
+        J4statusNlWifiInfo info;
     } wifi;
+    /* The scan and station answers being collected */
+    struct {
+        gboolean pending;
+        gboolean dirty;
+        J4statusNlWifiInfo info;
+        gboolean has_status;
+        guint32 status;
+        guint8 bssid[ETH_ALEN];
+        gboolean has_bssid;
+    } refresh;
     struct {
         gboolean has;
         GList *ipv4;
@@ -177,155 +199,97 @@ typedef struct {
     } addresses;
 } J4statusNlSection;
 
-static int
-_j4status_nl_message_error_callback(struct sockaddr_nl *nla, struct nlmsgerr *error, void *user_data)
-{
-    J4statusNlMessageAnswer *data = user_data;
-    data->error = error->error;
-    return NL_STOP;
-}
-
-static int
-_j4status_nl_message_ack_callback(struct nl_msg *msg, void *user_data)
-{
-    J4statusNlMessageAnswer *data = user_data;
-    data->error = 0;
-    return NL_STOP;
-}
-
-static int
-_j4status_nl_message_valid_callback(struct nl_msg *msg, void *user_data)
-{
-    J4statusNlMessageAnswer *data = user_data;
-    struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
-
-    ++data->number;
-    nla_parse(data->answer, data->size, genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0), NULL);
+typedef struct {
+    /* NULL once the section is gone, we still wait for the answer */
+    J4statusNlSection *section;
+    J4statusNlRequestType type;
+} J4statusNlRequest;
 
-    return NL_SKIP;
-}
+static void _j4status_nl_section_update(J4statusNlSection *self);
+static void _j4status_nl_section_update_nl80211(J4statusNlSection *self);
 
-static int
-_j4status_nl_send_message(J4statusPluginContext *self, struct nl_msg *message, struct nlattr **answer, int size, gsize *number)
+static gboolean
+_j4status_nl_register_events(J4statusPluginContext *self)
 {
-    self->nl80211.data.error = 1;
-    self->nl80211.data.answer = answer;
-    self->nl80211.data.size = size;
-    self->nl80211.data.number = 0;
+    static const gchar * const groups[] = {
+        NL80211_MULTICAST_GROUP_CONFIG,
+        NL80211_MULTICAST_GROUP_MLME,
+        NL80211_MULTICAST_GROUP_SCAN,
+    };
+    gboolean ret = FALSE;
 
-    int err;
-    err = nl_send_auto_complete(self->nl80211.sock, message);
-    if ( err < 0 )
+    gsize i;
+    for ( i = 0 ; i < G_N_ELEMENTS(groups) ; ++i )
     {
-        g_warning("Couldn’t send message: %s", nl_geterror(err));
-        return 1;
-    }
+        int id;
+        id = genl_ctrl_resolve_grp(self->nl80211.esock, NL80211_GENL_NAME, groups[i]);
+        if ( id < 0 )
+            continue;
 
-    while ( self->nl80211.data.error > 0 )
-        nl_recvmsgs_default(self->nl80211.sock);
+        int err;
+        err = nl_socket_add_membership(self->nl80211.esock, id);
+        if ( err < 0 )
+        {
+            g_warning("Couldn’t register to %s events: %s", groups[i], nl_geterror(err));
+            return FALSE;
+        }
+        ret = TRUE;
+    }
 
-    if ( number != NULL )
-        *number = self->nl80211.data.number;
+    if ( ! ret )
+        g_warning("Couldn’t get multicast groups ids");
 
-    return self->nl80211.data.error;
+    return ret;
 }
 
+/*
+ * Requests are only sent here, the answers are dispatched
+ * by the GWaterNlSource and matched on their sequence number
+ */
 static gboolean
-_j4status_nl_register_events(J4statusPluginContext *self)
+_j4status_nl_section_send_request(J4statusNlSection *self, J4statusNlRequestType type, int flags, guint8 cmd, const guint8 *mac)
 {
+    J4statusPluginContext *context = self->context;
     struct nl_msg *message;
 
     message = nlmsg_alloc();
     if ( message == NULL )
         return FALSE;
 
-    gboolean ret = FALSE;
-
-    int ctrlid;
-    ctrlid = genl_ctrl_resolve(self->nl80211.esock, "nlctrl");
-
-    genlmsg_put(message, NL_AUTO_PORT, NL_AUTO_SEQ, ctrlid, 0, 0, CTRL_CMD_GETFAMILY, 0);
-    NLA_PUT_STRING(message, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME);
+    genlmsg_put(message, NL_AUTO_PORT, NL_AUTO_SEQ, context->nl80211.id, 0, flags, cmd, 0);
+    NLA_PUT_U32(message, NL80211_ATTR_IFINDEX, self->ifindex);
+    if ( mac != NULL )
+        NLA_PUT(message, NL80211_ATTR_MAC, ETH_ALEN, mac);
 
-    struct nlattr *answer[CTRL_ATTR_MAX + 1];
     int err;
-    if ( ( err = _j4status_nl_send_message(self, message, answer, CTRL_ATTR_MAX, NULL) ) != 0 )
+    err = nl_send_auto_complete(context->nl80211.sock, message);
+    if ( err < 0 )
     {
-        if ( err < 0 )
-            g_warning("Couldn’t get multicast groups ids: %s", nl_geterror(err));
-        goto fail;
+        g_warning("Couldn’t send message: %s", nl_geterror(err));
+        goto nla_put_failure;
     }
 
-    if ( answer[CTRL_ATTR_MCAST_GROUPS] == NULL )
-        goto fail;
-
-    struct nlattr *group;
-    int rem;
-    nla_for_each_nested(group, answer[CTRL_ATTR_MCAST_GROUPS], rem)
-    {
-        struct nlattr *group_attr[CTRL_ATTR_MCAST_GRP_MAX + 1];
-
-        nla_parse(group_attr, CTRL_ATTR_MCAST_GRP_MAX, nla_data(group), nla_len(group), NULL);
-
-        if ( ( group_attr[CTRL_ATTR_MCAST_GRP_NAME] == NULL ) || ( group_attr[CTRL_ATTR_MCAST_GRP_ID] == NULL ) )
-            continue;
-
-        const char *name = nla_data(group_attr[CTRL_ATTR_MCAST_GRP_NAME]);
-        size_t n = nla_len(group_attr[CTRL_ATTR_MCAST_GRP_NAME]);
-        if ( ( strncmp(name, NL80211_MULTICAST_GROUP_CONFIG, n) != 0 )
-             && ( strncmp(name, NL80211_MULTICAST_GROUP_MLME, n) != 0 )
-             && ( strncmp(name, NL80211_MULTICAST_GROUP_SCAN, n) != 0 ) )
-            continue;
+    J4statusNlRequest *request;
+    request = g_new0(J4statusNlRequest, 1);
+    request->section = self;
+    request->type = type;
+    g_hash_table_insert(context->nl80211.requests, GUINT_TO_POINTER(nlmsg_hdr(message)->nlmsg_seq), request);
 
-        int id = nla_get_u32(group_attr[CTRL_ATTR_MCAST_GRP_ID]);
-        err = nl_socket_add_membership(self->nl80211.esock, id);
-        if ( err < 0 )
-        {
-            ret = FALSE;
-            g_warning("Couldn’t register to %.*s events: %s", (int) n, name, nl_geterror(err));
-            goto fail;
-        }
-        ret = TRUE;
-    }
+    nlmsg_free(message);
+    return TRUE;
 
 nla_put_failure:
-fail:
     nlmsg_free(message);
-    return ret;
+    return FALSE;
 }
 
 static void
-_j4status_nl_section_update_nl80211(J4statusNlSection *self)
+_j4status_nl_section_scan_result(J4statusNlSection *self, struct nlattr **answer)
 {
-    g_return_if_fail(self->wifi.is);
-
-    self->wifi.has_ap = FALSE;
-    g_free(self->wifi.ssid);
-    self->wifi.ssid = NULL;
-    self->wifi.strength = -1;
-    self->wifi.bitrate = 0;
-    self->wifi.aps = -1;
-
-    struct nl_msg *message;
-
-    message = nlmsg_alloc();
-    genlmsg_put(message, NL_AUTO_PORT, NL_AUTO_SEQ, self->context->nl80211.id, 0, NLM_F_DUMP, NL80211_CMD_GET_SCAN, 0);
-    NLA_PUT_U32(message, NL80211_ATTR_IFINDEX, self->ifindex);
-
-    int err;
-    struct nlattr *answer[NUM_NL80211_ATTR] = { NULL };
-    gsize aps;
-    if ( ( err = _j4status_nl_send_message(self->context, message, answer, NL80211_ATTR_MAX, &aps) ) != 0 )
-    {
-        if ( err < 0 )
-            g_warning("Couldn’t query nl80211 scan information: %s", nl_geterror(err));
-        goto end;
-    }
-
-    self->wifi.aps = aps;
+    ++self->refresh.info.aps;
 
     if ( answer[NL80211_ATTR_BSS] == NULL )
-        goto end;
+        return;
     struct nlattr *bss[NL80211_BSS_MAX + 1] = { NULL };
     static struct nla_policy bss_policy[NL80211_BSS_MAX + 1] = {
         [NL80211_BSS_FREQUENCY] = { .type = NLA_U32 },
@@ -334,10 +298,20 @@ _j4status_nl_section_update_nl80211(J4statusNlSection *self)
         [NL80211_BSS_STATUS] = { .type = NLA_U32 },
     };
     if ( nla_parse_nested(bss, NL80211_BSS_MAX, answer[NL80211_ATTR_BSS], bss_policy) < 0 )
-        goto end;
+        return;
 
+    /* Only the BSS we are using has a status */
     if ( bss[NL80211_BSS_STATUS] == NULL )
-        goto end;
+        return;
+
+    self->refresh.has_status = TRUE;
+    self->refresh.status = nla_get_u32(bss[NL80211_BSS_STATUS]);
+
+    if ( ( bss[NL80211_BSS_BSSID] != NULL ) && ( nla_len(bss[NL80211_BSS_BSSID]) == ETH_ALEN ) )
+    {
+        memcpy(self->refresh.bssid, nla_data(bss[NL80211_BSS_BSSID]), ETH_ALEN);
+        self->refresh.has_bssid = TRUE;
+    }
 
     if ( bss[NL80211_BSS_INFORMATION_ELEMENTS] != NULL )
     {
@@ -354,38 +328,19 @@ _j4status_nl_section_update_nl80211(J4statusNlSection *self)
             switch ( type )
             {
             case 0: /* SSID */
-                self->wifi.ssid = g_strndup((gchar *) c, size);
+                g_free(self->refresh.info.ssid);
+                self->refresh.info.ssid = g_strndup((gchar *) c, size);
             break;
             }
         }
     }
+}
 
-    switch ( nla_get_u32(bss[NL80211_BSS_STATUS]) )
-    {
-    case NL80211_BSS_STATUS_ASSOCIATED:
-    break;
-    case NL80211_BSS_STATUS_AUTHENTICATED:
-        goto has_ap;
-    case NL80211_BSS_STATUS_IBSS_JOINED:
-        goto has_ap;
-    default:
-        goto end;
-    }
-
-    nlmsg_free(message);
-    message = nlmsg_alloc();
-    genlmsg_put(message, NL_AUTO_PORT, NL_AUTO_SEQ, self->context->nl80211.id, 0, 0, NL80211_CMD_GET_STATION, 0);
-    NLA_PUT_U32(message, NL80211_ATTR_IFINDEX, self->ifindex);
-    NLA_PUT(message, NL80211_ATTR_MAC, nla_len(bss[NL80211_BSS_BSSID]), nla_data(bss[NL80211_BSS_BSSID]));
-    if ( ( err = _j4status_nl_send_message(self->context, message, answer, NL80211_ATTR_MAX, NULL) ) != 0 )
-    {
-        if ( err < 0 )
-            g_warning("Couldn’t query nl80211 station: %s", nl_geterror(err));
-        goto end;
-    }
-
+static void
+_j4status_nl_section_station_result(J4statusNlSection *self, struct nlattr **answer)
+{
     if ( answer[NL80211_ATTR_STA_INFO] == NULL )
-        goto end;
+        return;
 
     struct nlattr *sinfo[NL80211_STA_INFO_MAX + 1];
     static struct nla_policy stats_policy[NL80211_STA_INFO_MAX + 1] = {
@@ -393,7 +348,7 @@ _j4status_nl_section_update_nl80211(J4statusNlSection *self)
         [NL80211_STA_INFO_TX_BITRATE] = { .type = NLA_NESTED },
     };
     if ( nla_parse_nested(sinfo, NL80211_STA_INFO_MAX, answer[NL80211_ATTR_STA_INFO], stats_policy) < 0 )
-        goto end;
+        return;
 
     if ( sinfo[NL80211_STA_INFO_TX_BITRATE] != NULL )
     {
@@ -404,7 +359,7 @@ _j4status_nl_section_update_nl80211(J4statusNlSection *self)
         };
 
         if ( nla_parse_nested(rinfo, NL80211_RATE_INFO_MAX, sinfo[NL80211_STA_INFO_TX_BITRATE], rate_policy) < 0 )
-            goto end;
+            return;
 
         gint64 rate = 0;
         if ( rinfo[NL80211_RATE_INFO_BITRATE32] != NULL )
@@ -412,52 +367,217 @@ _j4status_nl_section_update_nl80211(J4statusNlSection *self)
         else if ( rinfo[NL80211_RATE_INFO_BITRATE] != NULL )
             rate = nla_get_u16(rinfo[NL80211_RATE_INFO_BITRATE]);
         if ( rate > 0 )
-            self->wifi.bitrate = rate * 100 * 1000;
+            self->refresh.info.bitrate = rate * 100 * 1000;
     }
 
     if ( sinfo[NL80211_STA_INFO_SIGNAL] != NULL )
     {
         gint8 dbm = (gint8) nla_get_u8(sinfo[NL80211_STA_INFO_SIGNAL]);
-        self->wifi.strength = ( 100 + CLAMP(dbm, -100, -50) ) * 2;
+        self->refresh.info.strength = ( 100 + CLAMP(dbm, -100, -50) ) * 2;
+    }
+}
+
+static void
+_j4status_nl_section_refresh_done(J4statusNlSection *self, gboolean has_ap)
+{
+    self->refresh.info.has_ap = has_ap;
+
+    g_free(self->wifi.info.ssid);
+    self->wifi.info = self->refresh.info;
+    self->refresh.info.ssid = NULL;
+    self->refresh.pending = FALSE;
+
+    _j4status_nl_section_update(self);
+
+    if ( self->refresh.dirty )
+        _j4status_nl_section_update_nl80211(self);
+}
+
+static void
+_j4status_nl_section_scan_done(J4statusNlSection *self, int error)
+{
+    if ( error != 0 )
+    {
+        g_warning("Couldn’t query nl80211 scan information: %s", nl_geterror(error));
+        self->refresh.info.aps = -1;
+        _j4status_nl_section_refresh_done(self, FALSE);
+        return;
     }
 
-has_ap:
-    self->wifi.has_ap = TRUE;
+    if ( ! self->refresh.has_status )
+    {
+        _j4status_nl_section_refresh_done(self, FALSE);
+        return;
+    }
 
-nla_put_failure:
-end:
-    nlmsg_free(message);
+    switch ( self->refresh.status )
+    {
+    case NL80211_BSS_STATUS_ASSOCIATED:
+        if ( self->refresh.has_bssid && _j4status_nl_section_send_request(self, REQUEST_STATION, 0, NL80211_CMD_GET_STATION, self->refresh.bssid) )
+            return;
+        _j4status_nl_section_refresh_done(self, FALSE);
+    break;
+    case NL80211_BSS_STATUS_AUTHENTICATED:
+    case NL80211_BSS_STATUS_IBSS_JOINED:
+        _j4status_nl_section_refresh_done(self, TRUE);
+    break;
+    default:
+        _j4status_nl_section_refresh_done(self, FALSE);
+    }
 }
 
-static gboolean
-_j4status_nl_section_check_nl80211(J4statusNlSection *self, const gchar *interface)
+static void
+_j4status_nl_scan_next(J4statusPluginContext *context)
 {
-    gboolean ret = FALSE;
-    struct nl_msg *message;
+    J4statusNlSection *section;
+    while ( ( ! context->nl80211.dumping ) && ( ( section = g_queue_pop_head(&context->nl80211.scans) ) != NULL ) )
+    {
+        /* Events so far are covered by this dump */
+        section->refresh.dirty = FALSE;
+        context->nl80211.dumping = _j4status_nl_section_send_request(section, REQUEST_SCAN, NLM_F_DUMP, NL80211_CMD_GET_SCAN, NULL);
+        if ( ! context->nl80211.dumping )
+            _j4status_nl_section_scan_done(section, -NLE_FAILURE);
+    }
+}
 
-    message = nlmsg_alloc();
-    genlmsg_put(message, NL_AUTO_PORT, NL_AUTO_SEQ, self->context->nl80211.id, 0, 0, NL80211_CMD_GET_INTERFACE, 0);
-    NLA_PUT_U32(message, NL80211_ATTR_IFINDEX, self->ifindex);
+static void
+_j4status_nl_section_update_nl80211(J4statusNlSection *self)
+{
+    g_return_if_fail(self->wifi.is);
 
-    int err;
-    struct nlattr *answer[NUM_NL80211_ATTR];
-    if ( ( err = _j4status_nl_send_message(self->context, message, answer, NL80211_ATTR_MAX, NULL) ) != 0 )
+    /* Events while a refresh is in flight only need one more */
+    if ( self->refresh.pending )
     {
-        if ( err == -NLE_NOADDR )
-            ret = TRUE;
-        else if ( err < 0 )
-            g_warning("Couldn’t query nl80211 status for %s: %s", interface, nl_geterror(err));
-        goto fail;
+        self->refresh.dirty = TRUE;
+        return;
     }
 
-    self->wifi.is = TRUE;
+    g_free(self->refresh.info.ssid);
+    self->refresh.pending = TRUE;
+    self->refresh.dirty = FALSE;
+    self->refresh.info.has_ap = FALSE;
+    self->refresh.info.ssid = NULL;
+    self->refresh.info.strength = -1;
+    self->refresh.info.bitrate = 0;
+    self->refresh.info.aps = 0;
+    self->refresh.has_status = FALSE;
+    self->refresh.has_bssid = FALSE;
+
+    g_queue_push_tail(&self->context->nl80211.scans, self);
+    _j4status_nl_scan_next(self->context);
+}
 
-    _j4status_nl_section_update_nl80211(self);
+static void
+_j4status_nl_section_check_nl80211(J4statusNlSection *self)
+{
+    if ( self->context->nl80211.source == NULL )
+        return;
+    self->wifi.checking = _j4status_nl_section_send_request(self, REQUEST_INTERFACE, 0, NL80211_CMD_GET_INTERFACE, NULL);
+}
 
-nla_put_failure:
-fail:
-    nlmsg_free(message);
-    return ret || self->wifi.is;
+static void
+_j4status_nl_request_done(J4statusPluginContext *context, guint32 seq, int error)
+{
+    J4statusNlRequest *request;
+    request = g_hash_table_lookup(context->nl80211.requests, GUINT_TO_POINTER(seq));
+    if ( request == NULL )
+        return;
+
+    J4statusNlSection *section = request->section;
+    J4statusNlRequestType type = request->type;
+    g_hash_table_remove(context->nl80211.requests, GUINT_TO_POINTER(seq));
+
+    if ( type == REQUEST_SCAN )
+    {
+        context->nl80211.dumping = FALSE;
+        if ( section != NULL )
+            _j4status_nl_section_scan_done(section, error);
+        _j4status_nl_scan_next(context);
+        return;
+    }
+
+    if ( section == NULL )
+        return;
+
+    switch ( type )
+    {
+    case REQUEST_INTERFACE:
+        section->wifi.checking = FALSE;
+        if ( error == 0 )
+        {
+            section->wifi.is = TRUE;
+            _j4status_nl_section_update_nl80211(section);
+        }
+        else
+        {
+            /* Not a wireless interface */
+            if ( error != -NLE_OBJ_NOTFOUND )
+                g_warning("Couldn’t query nl80211 status for %s: %s", rtnl_link_get_name(section->link), nl_geterror(error));
+            _j4status_nl_section_update(section);
+        }
+    break;
+    case REQUEST_SCAN:
+    break;
+    case REQUEST_STATION:
+        if ( error != 0 )
+            g_warning("Couldn’t query nl80211 station: %s", nl_geterror(error));
+        _j4status_nl_section_refresh_done(section, ( error == 0 ));
+    break;
+    }
+}
+
+static int
+_j4status_nl_message_error_callback(struct sockaddr_nl *nla, struct nlmsgerr *error, void *user_data)
+{
+    J4statusPluginContext *context = user_data;
+    _j4status_nl_request_done(context, error->msg.nlmsg_seq, -nl_syserr2nlerr(error->error));
+    /* Other answers may follow in the same buffer */
+    return NL_SKIP;
+}
+
+static int
+_j4status_nl_message_ack_callback(struct nl_msg *msg, void *user_data)
+{
+    J4statusPluginContext *context = user_data;
+    _j4status_nl_request_done(context, nlmsg_hdr(msg)->nlmsg_seq, 0);
+    return NL_OK;
+}
+
+static int
+_j4status_nl_message_valid_callback(struct nl_msg *msg, void *user_data)
+{
+    J4statusPluginContext *context = user_data;
+    J4statusNlRequest *request;
+
+    request = g_hash_table_lookup(context->nl80211.requests, GUINT_TO_POINTER(nlmsg_hdr(msg)->nlmsg_seq));
+    if ( ( request == NULL ) || ( request->section == NULL ) )
+        return NL_SKIP;
+
+    struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+    struct nlattr *answer[NUM_NL80211_ATTR] = { NULL };
+    nla_parse(answer, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0), NULL);
+
+    switch ( request->type )
+    {
+    case REQUEST_INTERFACE:
+    break;
+    case REQUEST_SCAN:
+        _j4status_nl_section_scan_result(request->section, answer);
+    break;
+    case REQUEST_STATION:
+        _j4status_nl_section_station_result(request->section, answer);
+    break;
+    }
+
+    return NL_OK;
+}
+
+static void
+_j4status_nl_request_forget_section(gpointer key, gpointer value, gpointer user_data)
+{
+    J4statusNlRequest *request = value;
+    if ( request->section == user_data )
+        request->section = NULL;
 }
 
 static GVariant *
@@ -524,17 +644,17 @@ _j4status_nl_format_up_wifi_callback(const gchar *token, guint64 value, gconstpo
     case TOKEN_UP_WIFI_ADDRESSES:
         return _j4status_nl_section_get_addresses(self);
     case TOKEN_UP_WIFI_STRENGTH:
-        if ( self->wifi.strength < 0 )
+        if ( self->wifi.info.strength < 0 )
             return NULL;
-        return g_variant_new_byte(self->wifi.strength);
+        return g_variant_new_byte(self->wifi.info.strength);
     case TOKEN_UP_WIFI_SSID:
-        if ( self->wifi.ssid == NULL )
+        if ( self->wifi.info.ssid == NULL )
             return NULL;
-        return g_variant_new_string(self->wifi.ssid);
+        return g_variant_new_string(self->wifi.info.ssid);
     case TOKEN_UP_WIFI_BITRATE:
-        if ( self->wifi.bitrate < 1 )
+        if ( self->wifi.info.bitrate < 1 )
             return NULL;
-        return g_variant_new_uint64(self->wifi.bitrate);
+        return g_variant_new_uint64(self->wifi.info.bitrate);
     }
     return NULL;
 }
@@ -547,9 +667,9 @@ _j4status_nl_format_down_wifi_callback(const gchar *token, guint64 value, gconst
     switch ( value )
     {
     case TOKEN_DOWN_WIFI_APS:
-        if ( self->wifi.aps < 0 )
+        if ( self->wifi.info.aps < 0 )
             return NULL;
-        return g_variant_new_uint64(self->wifi.aps);
+        return g_variant_new_uint64(self->wifi.info.aps);
     }
     return NULL;
 }
@@ -593,12 +713,12 @@ _j4status_nl_section_update(J4statusNlSection *self)
     else if ( ! self->addresses.has )
     {
         state = J4STATUS_STATE_AVERAGE;
-        if ( self->wifi.is && self->wifi.has_ap )
+        if ( self->wifi.is && self->wifi.info.has_ap )
         {
-            if ( self->wifi.ssid == NULL )
+            if ( self->wifi.info.ssid == NULL )
                 value = g_strdup("Associating");
             else
-                value = g_strdup_printf("Associating with %s", self->wifi.ssid);
+                value = g_strdup_printf("Associating with %s", self->wifi.info.ssid);
         }
         else
             value = g_strdup("Connecting");
@@ -659,8 +779,11 @@ _j4status_nl_section_add_address(J4statusNlSection *self, struct rtnl_addr *rtad
     gboolean had = self->addresses.has;
     self->addresses.has = TRUE;
 
-    gboolean need = ( ( ( ! self->wifi.is ) && ( self->context->formats.up_tokens & TOKEN_FLAG_UP_ADDRESSES ) )
-                      || ( self->wifi.is && ( self->context->formats.up_wifi_tokens & TOKEN_FLAG_UP_WIFI_ADDRESSES) ) );
+    /* While we do not know yet if it is a wireless interface, keep them for both formats */
+    gboolean wired = ( self->wifi.checking || ( ! self->wifi.is ) );
+    gboolean wifi = ( self->wifi.checking || self->wifi.is );
+    gboolean need = ( ( wired && ( self->context->formats.up_tokens & TOKEN_FLAG_UP_ADDRESSES ) )
+                      || ( wifi && ( self->context->formats.up_wifi_tokens & TOKEN_FLAG_UP_WIFI_ADDRESSES) ) );
     if ( ! need )
         return ( ! had );
 
@@ -677,10 +800,17 @@ _j4status_nl_section_free(gpointer data)
 {
     J4statusNlSection *self = data;
 
+    if ( self->context->nl80211.requests != NULL )
+        g_hash_table_foreach(self->context->nl80211.requests, _j4status_nl_request_forget_section, self);
+    g_queue_remove(&self->context->nl80211.scans, self);
+
     j4status_section_free(self->section);
 
     _j4status_nl_section_free_addresses(self);
 
+    g_free(self->refresh.info.ssid);
+    g_free(self->wifi.info.ssid);
+
     rtnl_link_put(self->link);
 
     g_free(self);
@@ -717,6 +847,8 @@ _j4status_nl_section_new(J4statusPluginContext *context, J4statusCoreInterface *
     self->context = context;
     self->ifindex = rtnl_link_get_ifindex(link);
     self->link = link;
+    self->wifi.info.strength = -1;
+    self->wifi.info.aps = -1;
 
     self->section = j4status_section_new(core);
 
@@ -730,7 +862,7 @@ _j4status_nl_section_new(J4statusPluginContext *context, J4statusCoreInterface *
         return NULL;
     }
 
-    _j4status_nl_section_check_nl80211(self, interface);
+    _j4status_nl_section_check_nl80211(self);
 
     struct nl_object *object;
     for ( object = nl_cache_get_first(context->addr_cache) ; object != NULL ; object = nl_cache_get_next(object) )
@@ -802,7 +934,8 @@ _j4status_nl_nl80211_event(struct nl_msg *msg, void *user_data)
         return NL_SKIP;
 
     section = g_hash_table_lookup(self->sections, GINT_TO_POINTER(nla_get_u32(answer[NL80211_ATTR_IFINDEX])));
-
+    if ( ( section == NULL ) || ( ! section->wifi.is ) )
+        return NL_SKIP;
 
     switch ( gnlh->cmd )
     {
@@ -936,10 +1069,14 @@ _j4status_nl_init(J4statusCoreInterface *core)
             goto error;
         }
 
-        nl_socket_modify_err_cb(self->nl80211.sock, NL_CB_CUSTOM, _j4status_nl_message_error_callback, &self->nl80211.data);
-        nl_socket_modify_cb(self->nl80211.sock, NL_CB_ACK, NL_CB_CUSTOM, _j4status_nl_message_ack_callback, &self->nl80211.data);
-        nl_socket_modify_cb(self->nl80211.sock, NL_CB_FINISH, NL_CB_CUSTOM, _j4status_nl_message_ack_callback, &self->nl80211.data);
-        nl_socket_modify_cb(self->nl80211.sock, NL_CB_VALID, NL_CB_CUSTOM, _j4status_nl_message_valid_callback, &self->nl80211.data);
+        self->nl80211.requests = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+        /* Several requests are in flight, we match answers ourselves */
+        nl_socket_modify_cb(self->nl80211.sock, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, _j4status_nl_nl80211_no_seq_check, self);
+        nl_socket_modify_err_cb(self->nl80211.sock, NL_CB_CUSTOM, _j4status_nl_message_error_callback, self);
+        nl_socket_modify_cb(self->nl80211.sock, NL_CB_ACK, NL_CB_CUSTOM, _j4status_nl_message_ack_callback, self);
+        nl_socket_modify_cb(self->nl80211.sock, NL_CB_FINISH, NL_CB_CUSTOM, _j4status_nl_message_ack_callback, self);
+        nl_socket_modify_cb(self->nl80211.sock, NL_CB_VALID, NL_CB_CUSTOM, _j4status_nl_message_valid_callback, self);
 
         self->nl80211.esource = g_water_nl_source_new_sock(NULL, NETLINK_GENERIC);
         if ( self->nl80211.esource == NULL )
@@ -999,6 +1136,10 @@ _j4status_nl_uninit(J4statusPluginContext *self)
 
     g_hash_table_unref(self->sections);
 
+    if ( self->nl80211.requests != NULL )
+        g_hash_table_unref(self->nl80211.requests);
+    g_queue_clear(&self->nl80211.scans);
+
     g_free(self);
 }
 
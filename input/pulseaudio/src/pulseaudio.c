@@ -42,6 +42,9 @@
 
 #define J4STATUS_PULSEAUDIO_DEFAULT_FORMAT "${volume[@% ]}%"
 
+/* Sink events are coalesced for about a frame */
+#define J4STATUS_PULSEAUDIO_REFRESH_DELAY 16
+
 typedef enum {
     TOKEN_PORT,
     TOKEN_MUTE,
@@ -74,6 +77,7 @@ struct _J4statusPluginContext {
     pa_context *context;
     pa_glib_mainloop *pa_loop;
     GHashTable *sections;
+    GHashTable *refreshes;
 };
 
 typedef enum {
@@ -111,8 +115,25 @@ typedef struct {
     guint32 index;
     pa_cvolume volume;
     gboolean mute;
+    J4statusPulseaudioPort port;
+    /* Local values win while we are sending them */
+    struct {
+        pa_operation *op;
+        gboolean dirty;
+    } set_volume, set_mute;
 } J4statusPulseaudioSection;
 
+/*
+ * At most one sink info request in flight per sink,
+ * events received meanwhile only mark it dirty
+ */
+typedef struct {
+    J4statusPluginContext *context;
+    guint32 index;
+    guint timeout_id;
+    pa_operation *op;
+    gboolean dirty;
+} J4statusPulseaudioRefresh;
 
 static void _j4status_pulseaudio_section_action_callback(J4statusSection *section_, const gchar *action_, gpointer user_data);
 
@@ -154,6 +175,17 @@ _j4status_pulseaudio_section_free(gpointer data)
 {
     J4statusPulseaudioSection *section = data;
 
+    if ( section->set_volume.op != NULL )
+    {
+        pa_operation_cancel(section->set_volume.op);
+        pa_operation_unref(section->set_volume.op);
+    }
+    if ( section->set_mute.op != NULL )
+    {
+        pa_operation_cancel(section->set_mute.op);
+        pa_operation_unref(section->set_mute.op);
+    }
+
     j4status_section_free(section->section);
 
     g_free(section);
@@ -184,27 +216,15 @@ _j4status_pulseaudio_format_callback(const gchar *token, guint64 value, gconstpo
 }
 
 static void
-_j4status_pulseaudio_sink_info_callback(pa_context *con, const pa_sink_info *i, int eol, void *user_data)
+_j4status_pulseaudio_section_render(J4statusPulseaudioSection *section)
 {
-    J4statusPluginContext *context = user_data;
-
-    if ( eol )
-        return;
-
-    J4statusPulseaudioSection *section;
-    section = _j4status_pulseaudio_section_get(context, i);
-    if ( section == NULL )
-        return;
-
-    pa_cvolume_set(&section->volume, i->volume.channels, PA_VOLUME_MUTED);
-    pa_cvolume_merge(&section->volume, &section->volume, &i->volume);
-    section->mute = i->mute;
+    J4statusPluginContext *context = section->context;
 
     guint8 c;
-    pa_volume_t vol = i->volume.values[0];
-    for ( c = 1 ; c < i->volume.channels ; ++c )
+    pa_volume_t vol = section->volume.values[0];
+    for ( c = 1 ; c < section->volume.channels ; ++c )
     {
-        if ( vol != i->volume.values[c] )
+        if ( vol != section->volume.values[c] )
             break;
     }
 
@@ -218,21 +238,15 @@ _j4status_pulseaudio_sink_info_callback(pa_context *con, const pa_sink_info *i,
 
     J4statusPulseaudioFormatData data = {
         .mute = section->mute,
-        .port = PORT_SPEAKER,
-        .volume = i->volume,
+        .port = section->port,
+        .volume = section->volume,
     };
 
-    if ( i->active_port != NULL )
-    {
-        if ( g_str_has_suffix(i->active_port->name, "-headphones") )
-            data.port = PORT_HEADPHONES;
-    }
-
     /*
      * We walked through the whole list and
      * all channels are sharing the same volume
      */
-    if ( c == i->volume.channels )
+    if ( c == section->volume.channels )
         data.volume.channels = 1;
 
     value = j4status_format_string_replace(context->config.format, _j4status_pulseaudio_format_callback, &data);
@@ -241,6 +255,123 @@ _j4status_pulseaudio_sink_info_callback(pa_context *con, const pa_sink_info *i,
     j4status_section_set_value(section->section, value);
 }
 
+static void
+_j4status_pulseaudio_sink_info_update(J4statusPluginContext *context, const pa_sink_info *i)
+{
+    J4statusPulseaudioSection *section;
+    section = _j4status_pulseaudio_section_get(context, i);
+    if ( section == NULL )
+        return;
+
+    /* Intermediate server states would make the display jump back */
+    if ( section->set_volume.op == NULL )
+    {
+        pa_cvolume_set(&section->volume, i->volume.channels, PA_VOLUME_MUTED);
+        pa_cvolume_merge(&section->volume, &section->volume, &i->volume);
+    }
+    if ( section->set_mute.op == NULL )
+        section->mute = i->mute;
+
+    section->port = PORT_SPEAKER;
+    if ( i->active_port != NULL )
+    {
+        if ( g_str_has_suffix(i->active_port->name, "-headphones") )
+            section->port = PORT_HEADPHONES;
+    }
+
+    _j4status_pulseaudio_section_render(section);
+}
+
+static void
+_j4status_pulseaudio_sink_info_callback(pa_context *con, const pa_sink_info *i, int eol, void *user_data)
+{
+    J4statusPluginContext *context = user_data;
+
+    if ( eol )
+        return;
+
+    _j4status_pulseaudio_sink_info_update(context, i);
+}
+
+static void
+_j4status_pulseaudio_refresh_free(gpointer data)
+{
+    J4statusPulseaudioRefresh *refresh = data;
+
+    if ( refresh->timeout_id > 0 )
+        g_source_remove(refresh->timeout_id);
+
+    if ( refresh->op != NULL )
+    {
+        pa_operation_cancel(refresh->op);
+        pa_operation_unref(refresh->op);
+    }
+
+    g_free(refresh);
+}
+
+static gboolean _j4status_pulseaudio_refresh_timeout(gpointer user_data);
+
+static void
+_j4status_pulseaudio_refresh_sink_info_callback(pa_context *con, const pa_sink_info *i, int eol, void *user_data)
+{
+    J4statusPulseaudioRefresh *refresh = user_data;
+
+    if ( eol == 0 )
+    {
+        _j4status_pulseaudio_sink_info_update(refresh->context, i);
+        return;
+    }
+
+    pa_operation_unref(refresh->op);
+    refresh->op = NULL;
+
+    if ( refresh->dirty )
+    {
+        refresh->dirty = FALSE;
+        refresh->timeout_id = g_timeout_add(J4STATUS_PULSEAUDIO_REFRESH_DELAY, _j4status_pulseaudio_refresh_timeout, refresh);
+    }
+    else
+        g_hash_table_remove(refresh->context->refreshes, GUINT_TO_POINTER(refresh->index));
+}
+
+static gboolean
+_j4status_pulseaudio_refresh_timeout(gpointer user_data)
+{
+    J4statusPulseaudioRefresh *refresh = user_data;
+    J4statusPluginContext *context = refresh->context;
+
+    refresh->timeout_id = 0;
+
+    refresh->op = pa_context_get_sink_info_by_index(context->context, refresh->index, _j4status_pulseaudio_refresh_sink_info_callback, refresh);
+    if ( refresh->op == NULL )
+        g_hash_table_remove(context->refreshes, GUINT_TO_POINTER(refresh->index));
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_j4status_pulseaudio_refresh(J4statusPluginContext *context, guint32 index)
+{
+    J4statusPulseaudioRefresh *refresh;
+
+    refresh = g_hash_table_lookup(context->refreshes, GUINT_TO_POINTER(index));
+    if ( refresh != NULL )
+    {
+        /* A scheduled request will see this change anyway */
+        if ( refresh->op != NULL )
+            refresh->dirty = TRUE;
+        return;
+    }
+
+    refresh = g_new0(J4statusPulseaudioRefresh, 1);
+    refresh->context = context;
+    refresh->index = index;
+    refresh->timeout_id = g_timeout_add(J4STATUS_PULSEAUDIO_REFRESH_DELAY, _j4status_pulseaudio_refresh_timeout, refresh);
+
+    g_hash_table_insert(context->refreshes, GUINT_TO_POINTER(index), refresh);
+}
+
 static void
 _j4status_pulseaudio_context_state_callback(pa_context *con, void *user_data)
 {
@@ -268,12 +399,66 @@ _j4status_pulseaudio_context_state_callback(pa_context *con, void *user_data)
     }
 }
 
+static void _j4status_pulseaudio_section_send_volume(J4statusPulseaudioSection *section);
+static void _j4status_pulseaudio_section_send_mute(J4statusPulseaudioSection *section);
+
+static void
+_j4status_pulseaudio_section_set_volume_callback(pa_context *con, gboolean success, gpointer user_data)
+{
+    J4statusPulseaudioSection *section = user_data;
+
+    pa_operation_unref(section->set_volume.op);
+    section->set_volume.op = NULL;
+
+    if ( section->set_volume.dirty )
+        _j4status_pulseaudio_section_send_volume(section);
+    else if ( ! success )
+        /* The sink change event will not come, reconcile */
+        _j4status_pulseaudio_refresh(section->context, section->index);
+}
+
 static void
-_j4status_pulseaudio_section_success_callback(pa_context *con, gboolean success, gpointer user_data)
+_j4status_pulseaudio_section_set_mute_callback(pa_context *con, gboolean success, gpointer user_data)
 {
     J4statusPulseaudioSection *section = user_data;
 
-    pa_context_get_sink_info_by_index(con, section->index, _j4status_pulseaudio_sink_info_callback, section->context);
+    pa_operation_unref(section->set_mute.op);
+    section->set_mute.op = NULL;
+
+    if ( section->set_mute.dirty )
+        _j4status_pulseaudio_section_send_mute(section);
+    else if ( ! success )
+        _j4status_pulseaudio_refresh(section->context, section->index);
+}
+
+/*
+ * Only one request in flight, repeated actions meanwhile
+ * are sent as one with the latest local value
+ */
+static void
+_j4status_pulseaudio_section_send_volume(J4statusPulseaudioSection *section)
+{
+    if ( section->set_volume.op != NULL )
+    {
+        section->set_volume.dirty = TRUE;
+        return;
+    }
+
+    section->set_volume.dirty = FALSE;
+    section->set_volume.op = pa_context_set_sink_volume_by_index(section->context->context, section->index, &section->volume, _j4status_pulseaudio_section_set_volume_callback, section);
+}
+
+static void
+_j4status_pulseaudio_section_send_mute(J4statusPulseaudioSection *section)
+{
+    if ( section->set_mute.op != NULL )
+    {
+        section->set_mute.dirty = TRUE;
+        return;
+    }
+
+    section->set_mute.dirty = FALSE;
+    section->set_mute.op = pa_context_set_sink_mute_by_index(section->context->context, section->index, section->mute, _j4status_pulseaudio_section_set_mute_callback, section);
 }
 
 static void
@@ -325,17 +510,18 @@ _j4status_pulseaudio_section_action_callback(J4statusSection *section_, const gc
 
     if ( set_volume )
     {
-        pa_cvolume cvolume;
-
-        pa_cvolume_set(&cvolume, section->volume.channels, PA_VOLUME_MUTED);
-        pa_cvolume_merge(&cvolume, &cvolume, &section->volume);
-        pa_cvolume_scale(&cvolume, volume);
-
-        pa_context_set_sink_volume_by_index(context->context, section->index, &cvolume, _j4status_pulseaudio_section_success_callback, section);
+        pa_cvolume_scale(&section->volume, volume);
+        _j4status_pulseaudio_section_send_volume(section);
     }
 
     if ( set_mute )
-        pa_context_set_sink_mute_by_index(context->context, section->index, mute, _j4status_pulseaudio_section_success_callback, section);
+    {
+        section->mute = mute;
+        _j4status_pulseaudio_section_send_mute(section);
+    }
+
+    /* Optimistic, reconciled by the next sink info */
+    _j4status_pulseaudio_section_render(section);
 }
 
 static void
@@ -343,9 +529,6 @@ _j4status_pulseaudio_context_event_callback(pa_context *con, pa_subscription_eve
 {
     J4statusPluginContext *context = user_data;
 
-    pa_operation *op;
-
-
     switch ( t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK )
     {
     case PA_SUBSCRIPTION_EVENT_SINK:
@@ -353,11 +536,10 @@ _j4status_pulseaudio_context_event_callback(pa_context *con, pa_subscription_eve
         {
         case PA_SUBSCRIPTION_EVENT_NEW:
         case PA_SUBSCRIPTION_EVENT_CHANGE:
-            op = pa_context_get_sink_info_by_index(con, idx, _j4status_pulseaudio_sink_info_callback, context);
-            if ( op != NULL )
-                pa_operation_unref(op);
+            _j4status_pulseaudio_refresh(context, idx);
         break;
         case PA_SUBSCRIPTION_EVENT_REMOVE:
+            g_hash_table_remove(context->refreshes, GUINT_TO_POINTER(idx));
             g_hash_table_remove(context->sections, GUINT_TO_POINTER(idx));
         break;
         default:
@@ -433,6 +615,7 @@ _j4status_pulseaudio_init(J4statusCoreInterface *core)
     pa_context_set_subscribe_callback(context->context, _j4status_pulseaudio_context_event_callback, context);
 
     context->sections = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, _j4status_pulseaudio_section_free);
+    context->refreshes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, _j4status_pulseaudio_refresh_free);
 
     pa_context_connect(context->context, NULL, 0, NULL);
 
@@ -442,6 +625,8 @@ _j4status_pulseaudio_init(J4statusCoreInterface *core)
 static void
 _j4status_pulseaudio_uninit(J4statusPluginContext *context)
 {
+    g_hash_table_unref(context->refreshes);
+
     pa_context_disconnect(context->context);
 
     g_hash_table_unref(context->sections);
@@ -0,0 +1,364 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "j4status-plugin-input.h"
+
+#define DEFAULT_MAX_SECTIONS 64
+#define MAX_MESSAGE_SIZE 4096
+
+static const struct {
+    const gchar *name;
+    J4statusState state;
+} _j4status_push_states[] = {
+    { "unavailable", J4STATUS_STATE_UNAVAILABLE },
+    { "bad",         J4STATUS_STATE_BAD },
+    { "average",     J4STATUS_STATE_AVERAGE },
+    { "good",        J4STATUS_STATE_GOOD },
+};
+
+struct _J4statusPluginContext {
+    J4statusCoreInterface *core;
+    gchar *path;
+    gint fd;
+    gboolean bound;
+    guint watch_id;
+    guint expiry_id;
+    GHashTable *sections;
+    struct {
+        guint max_sections;
+        guint64 expiry;
+    } config;
+    gboolean full_warned;
+    gchar buffer[MAX_MESSAGE_SIZE + 1];
+};
+
+typedef struct {
+    J4statusSection *section;
+    gchar *id;
+    gint64 last_update;
+} J4statusPushSection;
+
+static void
+_j4status_push_section_free(gpointer data)
+{
+    J4statusPushSection *section = data;
+
+    j4status_section_free(section->section);
+    g_free(section->id);
+
+    g_free(section);
+}
+
+static J4statusPushSection *
+_j4status_push_section_get(J4statusPluginContext *context, const gchar *id)
+{
+    J4statusPushSection *section;
+    section = g_hash_table_lookup(context->sections, id);
+    if ( section != NULL )
+        return section;
+
+    if ( g_hash_table_size(context->sections) >= context->config.max_sections )
+    {
+        if ( ! context->full_warned )
+            g_warning("Too many sections, dropping messages for new ones");
+        context->full_warned = TRUE;
+        return NULL;
+    }
+
+    section = g_new0(J4statusPushSection, 1);
+    section->id = g_strdup(id);
+    section->section = j4status_section_new(context->core);
+
+    j4status_section_set_name(section->section, "push");
+    j4status_section_set_instance(section->section, id);
+
+    if ( ! j4status_section_insert(section->section) )
+    {
+        _j4status_push_section_free(section);
+        return NULL;
+    }
+
+    g_hash_table_insert(context->sections, section->id, section);
+    return section;
+}
+
+static gboolean
+_j4status_push_parse_state(const gchar *word, J4statusState *state)
+{
+    gsize l = strlen(word);
+    J4statusState urgent = 0;
+
+    if ( ( l > 0 ) && ( word[l - 1] == '!' ) )
+    {
+        urgent = J4STATUS_STATE_URGENT;
+        --l;
+    }
+
+    gsize i;
+    for ( i = 0 ; i < G_N_ELEMENTS(_j4status_push_states) ; ++i )
+    {
+        if ( ( strncmp(word, _j4status_push_states[i].name, l) == 0 ) && ( _j4status_push_states[i].name[l] == '\0' ) )
+        {
+            *state = _j4status_push_states[i].state | urgent;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * Parsed in place, the only allocations are the value
+ * and, for the first message of an id, the section
+ */
+static void
+_j4status_push_message(J4statusPluginContext *context, gchar *message, gsize length)
+{
+    while ( ( length > 0 ) && ( ( message[length - 1] == '\n' ) || ( message[length - 1] == '\r' ) ) )
+        --length;
+    message[length] = '\0';
+
+    gchar *id = message;
+    gchar *value = strchr(message, ' ');
+    if ( value != NULL )
+        *value++ = '\0';
+
+    if ( *id == '\0' )
+        return;
+
+    /* Anyone can write to the socket, only pass valid text along */
+    if ( ! g_utf8_validate(id, -1, NULL) )
+        return;
+    if ( ( value != NULL ) && ( ! g_utf8_validate(value, -1, NULL) ) )
+        return;
+
+    if ( ( value == NULL ) || ( *value == '\0' ) )
+    {
+        /* A bare id removes the section */
+        if ( g_hash_table_remove(context->sections, id) )
+            context->full_warned = FALSE;
+        return;
+    }
+
+    J4statusState state = J4STATUS_STATE_NO_STATE;
+    gchar *last = strrchr(value, ' ');
+    if ( ( last != NULL ) && _j4status_push_parse_state(last + 1, &state) )
+        *last = '\0';
+
+    J4statusPushSection *section;
+    section = _j4status_push_section_get(context, id);
+    if ( section == NULL )
+        return;
+
+    section->last_update = g_get_monotonic_time();
+    j4status_section_set_state(section->section, state);
+    j4status_section_set_value(section->section, g_strdup(value));
+}
+
+static gboolean
+_j4status_push_callback(gint fd, GIOCondition condition, gpointer user_data)
+{
+    J4statusPluginContext *context = user_data;
+    gssize r;
+
+    while ( ( r = recv(fd, context->buffer, MAX_MESSAGE_SIZE, 0) ) >= 0 )
+        _j4status_push_message(context, context->buffer, r);
+
+    if ( ( errno != EAGAIN ) && ( errno != EWOULDBLOCK ) && ( errno != EINTR ) )
+    {
+        g_warning("Couldn't receive messages: %s", g_strerror(errno));
+        context->watch_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+_j4status_push_expire(gpointer user_data)
+{
+    J4statusPluginContext *context = user_data;
+    gint64 limit = g_get_monotonic_time() - context->config.expiry * G_USEC_PER_SEC;
+
+    GHashTableIter iter;
+    gpointer section;
+    g_hash_table_iter_init(&iter, context->sections);
+    while ( g_hash_table_iter_next(&iter, NULL, &section) )
+    {
+        if ( ((J4statusPushSection *) section)->last_update < limit )
+        {
+            g_hash_table_iter_remove(&iter);
+            context->full_warned = FALSE;
+        }
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/*
+ * Only remove a stale socket: the path must be a socket
+ * and nobody must be listening on it anymore
+ */
+static gboolean
+_j4status_push_remove_stale_socket(const struct sockaddr_un *address)
+{
+    struct stat st;
+    if ( lstat(address->sun_path, &st) < 0 )
+        return ( errno == ENOENT );
+
+    if ( ! S_ISSOCK(st.st_mode) )
+    {
+        g_warning("'%s' exists and is not a socket", address->sun_path);
+        return FALSE;
+    }
+
+    gint fd;
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if ( fd < 0 )
+        return FALSE;
+
+    gboolean alive = ( connect(fd, (const struct sockaddr *) address, sizeof(*address)) == 0 );
+    close(fd);
+    if ( alive )
+    {
+        g_warning("Socket '%s' is already in use", address->sun_path);
+        return FALSE;
+    }
+
+    unlink(address->sun_path);
+    return TRUE;
+}
+
+static void _j4status_push_uninit(J4statusPluginContext *context);
+
+static J4statusPluginContext *
+_j4status_push_init(J4statusCoreInterface *core)
+{
+    gchar *path = NULL;
+    guint64 max_sections = 0;
+    guint64 expiry = 0;
+
+    GKeyFile *key_file;
+    key_file = j4status_config_get_key_file("Push");
+    if ( key_file != NULL )
+    {
+        path = g_key_file_get_string(key_file, "Push", "Socket", NULL);
+        max_sections = g_key_file_get_uint64(key_file, "Push", "MaxSections", NULL);
+        expiry = g_key_file_get_uint64(key_file, "Push", "Expiry", NULL);
+        g_key_file_free(key_file);
+    }
+
+    if ( path == NULL )
+    {
+        gchar *dir;
+        dir = g_build_filename(g_get_user_runtime_dir(), PACKAGE_NAME, NULL);
+        if ( ( ! g_file_test(dir, G_FILE_TEST_IS_DIR) ) && ( g_mkdir_with_parents(dir, 0755) < 0 ) )
+        {
+            g_warning("Couldn't create the socket directory '%s': %s", dir, g_strerror(errno));
+            g_free(dir);
+            return NULL;
+        }
+        path = g_build_filename(dir, "push", NULL);
+        g_free(dir);
+    }
+
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if ( strlen(path) >= sizeof(address.sun_path) )
+    {
+        g_warning("Socket path '%s' is too long", path);
+        g_free(path);
+        return NULL;
+    }
+    strcpy(address.sun_path, path);
+
+    J4statusPluginContext *context;
+    context = g_new0(J4statusPluginContext, 1);
+    context->core = core;
+    context->path = path;
+    context->config.max_sections = ( max_sections > 0 ) ? MIN(max_sections, G_MAXUINT) : DEFAULT_MAX_SECTIONS;
+    context->config.expiry = expiry;
+    context->sections = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, _j4status_push_section_free);
+
+    context->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if ( context->fd < 0 )
+    {
+        g_warning("Couldn't create socket: %s", g_strerror(errno));
+        goto fail;
+    }
+
+    if ( ! _j4status_push_remove_stale_socket(&address) )
+        goto fail;
+
+    if ( bind(context->fd, (struct sockaddr *) &address, sizeof(address)) < 0 )
+    {
+        g_warning("Couldn't bind socket '%s': %s", path, g_strerror(errno));
+        goto fail;
+    }
+    context->bound = TRUE;
+
+    context->watch_id = g_unix_fd_add(context->fd, G_IO_IN, _j4status_push_callback, context);
+    if ( context->config.expiry > 0 )
+        context->expiry_id = g_timeout_add_seconds(MAX(1, MIN(context->config.expiry / 2, G_MAXUINT)), _j4status_push_expire, context);
+
+    return context;
+
+fail:
+    _j4status_push_uninit(context);
+    return NULL;
+}
+
+static void
+_j4status_push_uninit(J4statusPluginContext *context)
+{
+    if ( context->expiry_id > 0 )
+        g_source_remove(context->expiry_id);
+    if ( context->watch_id > 0 )
+        g_source_remove(context->watch_id);
+
+    if ( context->fd >= 0 )
+        close(context->fd);
+    if ( context->bound )
+        unlink(context->path);
+
+    g_hash_table_unref(context->sections);
+    g_free(context->path);
+
+    g_free(context);
+}
+
+J4STATUS_EXPORT void
+j4status_input_plugin(J4statusInputPluginInterface *interface)
+{
+    libj4status_input_plugin_interface_add_init_callback(interface, _j4status_push_init);
+    libj4status_input_plugin_interface_add_uninit_callback(interface, _j4status_push_uninit);
+}
@@ -24,52 +24,363 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <glib.h>
+#include <glib/gprintf.h>
+#include <glib-unix.h>
 #include <sensors/sensors.h>
 
 #include "j4status-plugin-input.h"
 
 #define MAX_CHIP_NAME_SIZE 256
+/* Thresholds almost never change, we only read them every that many ticks */
+#define THRESHOLDS_REFRESH_TICKS 30
+/* Readings above that fraction of a threshold keep the fast polling rate */
+#define THRESHOLDS_NEAR_RATIO 0.9
+/* Number of quiet ticks before switching to the slow polling rate */
+#define STABLE_TICKS 5
+/* While stopped, we only check critical alarms that often */
+#define CRIT_WATCH_INTERVAL 30
+
+typedef enum {
+    REDUCE_MAX,
+    REDUCE_MIN,
+    REDUCE_AVG,
+} J4statusSensorsReduce;
+
+static const gchar * const _j4status_sensors_reduce[] = {
+    [REDUCE_MAX] = "max",
+    [REDUCE_MIN] = "min",
+    [REDUCE_AVG] = "avg",
+};
+
+typedef struct _J4statusSensorsGroup J4statusSensorsGroup;
 
 struct _J4statusPluginContext {
     J4statusCoreInterface *core;
     GList *sections;
+    GList *groups;
     struct {
         gboolean show_details;
+        gboolean fast_read;
+        gdouble smoothing;
+        struct {
+            gdouble temp;
+            gdouble fan;
+        } hysteresis;
+        struct {
+            guint fast;
+            guint slow;
+        } interval;
     } config;
+    guint64 ticks;
+    guint stable_ticks;
+    guint interval;
+    guint timeout_id;
+    guint crit_watch_id;
     gboolean started;
 };
 
 typedef struct {
+    J4statusPluginContext *context;
+    /* NULL for hidden group members */
     J4statusSection *section;
+    J4statusSensorsGroup *group;
     const sensors_chip_name *chip;
     const sensors_feature *feature;
     struct {
         const sensors_subfeature *input;
         const sensors_subfeature *max;
         const sensors_subfeature *crit;
+        const sensors_subfeature *alarm;
     } subfeatures;
+    /* Fast reader: hwmon attribute files kept open, -1 to use libsensors */
+    struct {
+        gint input;
+        gint max;
+        gint crit;
+        gint alarm;
+    } fds;
+    guint alarm_watch_id;
+    gdouble scale;
+    gdouble hysteresis;
+    struct {
+        gdouble input;
+        gdouble max;
+        gdouble crit;
+    } readings;
+    gdouble smoothed;
     struct {
+        J4statusState state;
         gdouble current;
         gdouble high;
         gdouble crit;
     } values;
+    /* Our contribution to the group aggregate */
+    struct {
+        gboolean valid;
+        gdouble value;
+        J4statusState state;
+    } member;
 } J4statusSensorsFeature;
 
+struct _J4statusSensorsGroup {
+    J4statusPluginContext *context;
+    J4statusSection *section;
+    gchar *name;
+    gchar **members;
+    gboolean show_members;
+    J4statusSensorsReduce reduce;
+    sensors_feature_type type;
+    gdouble hysteresis;
+    GPtrArray *features;
+    /* Updated incrementally as members are fed */
+    struct {
+        guint count;
+        gdouble sum;
+        J4statusSensorsFeature *extreme;
+        gboolean rescan;
+        guint bad;
+        guint urgent;
+    } aggregate;
+    gboolean dirty;
+    struct {
+        J4statusState state;
+        gdouble current;
+    } values;
+};
+
+/* Readings can be negative, so a missing one is NAN */
+static gdouble
+_j4status_sensors_feature_read_value(J4statusSensorsFeature *feature, const sensors_subfeature *subfeature, gint fd)
+{
+    if ( subfeature == NULL )
+        return NAN;
+
+    if ( fd < 0 )
+    {
+        double value;
+        if ( sensors_get_value(feature->chip, subfeature->number, &value) < 0 )
+            return NAN;
+        return value;
+    }
+
+    gchar buffer[32];
+    gssize r;
+    r = pread(fd, buffer, sizeof(buffer) - 1, 0);
+    if ( r <= 0 )
+        return NAN;
+    buffer[r] = '\0';
+
+    return g_ascii_strtod(buffer, NULL) / feature->scale;
+}
+
 static void
-_j4status_sensors_feature_temp_update(J4statusPluginContext *context, J4statusSensorsFeature *feature)
+_j4status_sensors_feature_read(J4statusSensorsFeature *feature, gboolean thresholds)
+{
+    feature->readings.input = _j4status_sensors_feature_read_value(feature, feature->subfeatures.input, feature->fds.input);
+    if ( ! thresholds )
+        return;
+    feature->readings.max = _j4status_sensors_feature_read_value(feature, feature->subfeatures.max, feature->fds.max);
+    feature->readings.crit = _j4status_sensors_feature_read_value(feature, feature->subfeatures.crit, feature->fds.crit);
+    /* Thresholds are only used when positive */
+    if ( isnan(feature->readings.max) )
+        feature->readings.max = -1;
+    if ( isnan(feature->readings.crit) )
+        feature->readings.crit = -1;
+}
+
+static gint
+_j4status_sensors_feature_open_attribute(const sensors_chip_name *chip, const sensors_subfeature *subfeature)
+{
+    if ( ( subfeature == NULL ) || ( chip->path == NULL ) )
+        return -1;
+
+    gchar *path;
+    gint fd;
+    path = g_build_filename(chip->path, subfeature->name, NULL);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if ( fd < 0 )
+        g_debug("Couldn't open '%s', falling back to libsensors: %s", path, g_strerror(errno));
+    g_free(path);
+
+    return fd;
+}
+
+static gint
+_j4status_sensors_feature_open(J4statusPluginContext *context, const sensors_chip_name *chip, const sensors_subfeature *subfeature)
+{
+    if ( ! context->config.fast_read )
+        return -1;
+    return _j4status_sensors_feature_open_attribute(chip, subfeature);
+}
+
+static gdouble
+_j4status_sensors_feature_smooth(J4statusPluginContext *context, J4statusSensorsFeature *feature)
+{
+    gdouble raw = feature->readings.input;
+
+    if ( isnan(raw) || isnan(feature->smoothed) || ( context->config.smoothing <= 0 ) )
+        feature->smoothed = raw;
+    else
+        feature->smoothed = context->config.smoothing * feature->smoothed + ( 1 - context->config.smoothing ) * raw;
+
+    return feature->smoothed;
+}
+
+static gboolean
+_j4status_sensors_feature_need_update(J4statusSensorsFeature *feature, J4statusState state, gdouble curr, gdouble high, gdouble crit)
 {
-    double curr;
-    sensors_get_value(feature->chip, feature->subfeatures.input->number, &curr);
+    if ( ( feature->values.state != state ) || ( feature->values.high != high ) || ( feature->values.crit != crit ) )
+        return TRUE;
+
+    if ( feature->values.current == curr )
+        return FALSE;
 
-    double high = -1;
-    if ( feature->subfeatures.max != NULL )
-        sensors_get_value(feature->chip, feature->subfeatures.max->number, &high);
+    return ( ABS(curr - feature->values.current) >= feature->hysteresis );
+}
+
+static gboolean
+_j4status_sensors_group_is_better(J4statusSensorsGroup *group, gdouble a, gdouble b)
+{
+    if ( group->reduce == REDUCE_MIN )
+        return ( a < b );
+    return ( a > b );
+}
 
-    double crit = -1;
-    if ( feature->subfeatures.crit != NULL )
-        sensors_get_value(feature->chip, feature->subfeatures.crit->number, &crit);
+static void
+_j4status_sensors_group_feed(J4statusSensorsGroup *group, J4statusSensorsFeature *feature, gdouble value, J4statusState state)
+{
+    gboolean valid = ( ! isnan(value) );
+
+    if ( ( feature->member.valid == valid ) && ( feature->member.value == value ) && ( feature->member.state == state ) )
+        return;
+    group->dirty = TRUE;
+
+    if ( feature->member.valid )
+    {
+        --group->aggregate.count;
+        group->aggregate.sum -= feature->member.value;
+    }
+    if ( valid )
+    {
+        ++group->aggregate.count;
+        group->aggregate.sum += value;
+    }
+
+    if ( group->aggregate.extreme == feature )
+    {
+        /* Our extreme got less extreme, someone else may be now */
+        if ( ( ! valid ) || _j4status_sensors_group_is_better(group, feature->member.value, value) )
+            group->aggregate.rescan = TRUE;
+    }
+    else if ( valid && ( ( group->aggregate.extreme == NULL ) || _j4status_sensors_group_is_better(group, value, group->aggregate.extreme->member.value) ) )
+        group->aggregate.extreme = feature;
+
+    if ( feature->member.state & J4STATUS_STATE_URGENT )
+        --group->aggregate.urgent;
+    if ( ( feature->member.state & ~J4STATUS_STATE_URGENT ) == J4STATUS_STATE_BAD )
+        --group->aggregate.bad;
+    if ( state & J4STATUS_STATE_URGENT )
+        ++group->aggregate.urgent;
+    if ( ( state & ~J4STATUS_STATE_URGENT ) == J4STATUS_STATE_BAD )
+        ++group->aggregate.bad;
+
+    feature->member.valid = valid;
+    feature->member.value = value;
+    feature->member.state = state;
+}
+
+/* Returns TRUE if the displayed value changed */
+static gboolean
+_j4status_sensors_group_update(J4statusSensorsGroup *group)
+{
+    if ( ! group->dirty )
+        return FALSE;
+    group->dirty = FALSE;
+
+    if ( group->aggregate.rescan )
+    {
+        group->aggregate.rescan = FALSE;
+        group->aggregate.extreme = NULL;
+
+        guint i;
+        for ( i = 0 ; i < group->features->len ; ++i )
+        {
+            J4statusSensorsFeature *feature = g_ptr_array_index(group->features, i);
+            if ( ! feature->member.valid )
+                continue;
+            if ( ( group->aggregate.extreme == NULL ) || _j4status_sensors_group_is_better(group, feature->member.value, group->aggregate.extreme->member.value) )
+                group->aggregate.extreme = feature;
+        }
+    }
+
+    if ( ( group->section == NULL ) || ( group->aggregate.count == 0 ) )
+        return FALSE;
+
+    J4statusState state = J4STATUS_STATE_GOOD;
+    if ( group->aggregate.bad > 0 )
+        state = J4STATUS_STATE_BAD;
+    if ( group->aggregate.urgent > 0 )
+        state |= J4STATUS_STATE_URGENT;
+
+    gdouble curr;
+    if ( group->reduce == REDUCE_AVG )
+        curr = group->aggregate.sum / group->aggregate.count;
+    else
+        curr = group->aggregate.extreme->member.value;
+
+    if ( ( ! group->context->started ) && ( ( state & J4STATUS_STATE_URGENT ) == 0 ) )
+        return FALSE;
+
+    if ( group->values.state == state )
+    {
+        if ( group->values.current == curr )
+            return FALSE;
+        if ( ABS(curr - group->values.current) < group->hysteresis )
+            return FALSE;
+    }
+
+    group->values.state = state;
+    group->values.current = curr;
+
+    j4status_section_set_state(group->section, state);
+
+    gchar *value;
+    if ( group->type == SENSORS_FEATURE_FAN )
+        value = g_strdup_printf("%.0frpm", curr);
+    else
+        value = g_strdup_printf("%+.1f°C", curr);
+    j4status_section_set_value(group->section, value);
+
+    return TRUE;
+}
+
+static void
+_j4status_sensors_feature_set_unavailable(J4statusSensorsFeature *feature)
+{
+    if ( feature->values.state == J4STATUS_STATE_UNAVAILABLE )
+        return;
+
+    feature->values.state = J4STATUS_STATE_UNAVAILABLE;
+    feature->values.current = NAN;
+
+    j4status_section_set_state(feature->section, J4STATUS_STATE_UNAVAILABLE);
+    j4status_section_set_value(feature->section, NULL);
+}
+
+/* Returns TRUE if the feature wants the fast polling rate */
+static gboolean
+_j4status_sensors_feature_temp_update(J4statusPluginContext *context, J4statusSensorsFeature *feature)
+{
+    double raw = feature->readings.input;
+    double curr = _j4status_sensors_feature_smooth(context, feature);
+    double high = feature->readings.max;
+    double crit = feature->readings.crit;
 
     J4statusState state;
 
@@ -78,15 +389,30 @@ _j4status_sensors_feature_temp_update(J4statusPluginContext *context, J4statusSe
     else
         state = J4STATUS_STATE_GOOD;
 
-    if ( ( crit > 0 ) && ( curr > crit ) )
-        state |= J4STATUS_STATE_URGENT;
+    /* Use the raw reading here, smoothing must not delay urgency */
+    if ( ( crit > 0 ) && ( raw > crit ) )
+        state = J4STATUS_STATE_BAD | J4STATUS_STATE_URGENT;
+
+    gboolean near = ( ( ( high > 0 ) && ( raw >= high * THRESHOLDS_NEAR_RATIO ) ) || ( ( crit > 0 ) && ( raw >= crit * THRESHOLDS_NEAR_RATIO ) ) );
+
+    if ( feature->group != NULL )
+        _j4status_sensors_group_feed(feature->group, feature, curr, state);
+    if ( feature->section == NULL )
+        return near;
 
     if ( ( ! context->started ) && ( ( state & J4STATUS_STATE_URGENT ) == 0 ) )
-        return;
+        return near;
 
-    if ( ( feature->values.current == curr ) && ( feature->values.high == high ) && ( feature->values.crit == crit ) )
-        return;
+    if ( isnan(curr) )
+    {
+        _j4status_sensors_feature_set_unavailable(feature);
+        return near;
+    }
 
+    if ( ! _j4status_sensors_feature_need_update(feature, state, curr, high, crit) )
+        return near;
+
+    feature->values.state = state;
     feature->values.current = curr;
     feature->values.high = high;
     feature->values.crit = crit;
@@ -106,17 +432,16 @@ _j4status_sensors_feature_temp_update(J4statusPluginContext *context, J4statusSe
     else
         value = g_strdup_printf("%+.1f°C", curr);
     j4status_section_set_value(feature->section, value);
+
+    return TRUE;
 }
 
-static void
+static gboolean
 _j4status_sensors_feature_fan_update(J4statusPluginContext *context, J4statusSensorsFeature *feature)
 {
-    double curr;
-    sensors_get_value(feature->chip, feature->subfeatures.input->number, &curr);
-
-    double high = -1;
-    if ( feature->subfeatures.max != NULL )
-        sensors_get_value(feature->chip, feature->subfeatures.max->number, &high);
+    double raw = feature->readings.input;
+    double curr = _j4status_sensors_feature_smooth(context, feature);
+    double high = feature->readings.max;
 
     J4statusState state;
 
@@ -125,12 +450,26 @@ _j4status_sensors_feature_fan_update(J4statusPluginContext *context, J4statusSen
     else
         state = J4STATUS_STATE_GOOD;
 
+    gboolean near = ( ( high > 0 ) && ( raw >= high * THRESHOLDS_NEAR_RATIO ) );
+
+    if ( feature->group != NULL )
+        _j4status_sensors_group_feed(feature->group, feature, curr, state);
+    if ( feature->section == NULL )
+        return near;
+
     if ( ( ! context->started ) && ( ( state & J4STATUS_STATE_URGENT ) == 0 ) )
-        return;
+        return near;
 
-    if ( ( feature->values.current == curr ) && ( feature->values.high == high ) )
-        return;
+    if ( isnan(curr) )
+    {
+        _j4status_sensors_feature_set_unavailable(feature);
+        return near;
+    }
 
+    if ( ! _j4status_sensors_feature_need_update(feature, state, curr, high, -1) )
+        return near;
+
+    feature->values.state = state;
     feature->values.current = curr;
     feature->values.high = high;
 
@@ -146,39 +485,210 @@ _j4status_sensors_feature_fan_update(J4statusPluginContext *context, J4statusSen
         value = g_strdup_printf("%.0frpm", curr);
 
     j4status_section_set_value(feature->section, value);
+
+    return TRUE;
 }
 
-static gboolean
-_j4status_sensors_update(gpointer user_data)
+/* Returns the polling interval wanted for the next tick */
+static guint
+_j4status_sensors_update(J4statusPluginContext *context)
 {
-    J4statusPluginContext *context = user_data;
+    gboolean busy = FALSE;
+    gboolean thresholds = ( ( context->ticks++ % THRESHOLDS_REFRESH_TICKS ) == 0 );
 
+    /* Read everything first, then update sections */
     GList *feature_;
+    for ( feature_ = context->sections ; feature_ != NULL ; feature_ = g_list_next(feature_) )
+        _j4status_sensors_feature_read(feature_->data, thresholds);
+
     for ( feature_ = context->sections ; feature_ != NULL ; feature_ = g_list_next(feature_) )
     {
         J4statusSensorsFeature *feature = feature_->data;
         switch ( feature->feature->type )
         {
         case SENSORS_FEATURE_TEMP:
-            _j4status_sensors_feature_temp_update(context, feature);
+            busy = _j4status_sensors_feature_temp_update(context, feature) || busy;
         break;
         case SENSORS_FEATURE_FAN:
-            _j4status_sensors_feature_fan_update(context, feature);
+            busy = _j4status_sensors_feature_fan_update(context, feature) || busy;
         break;
         default:
-            g_return_val_if_reached(G_SOURCE_CONTINUE);
+            g_return_val_if_reached(context->config.interval.fast);
+        }
+    }
+
+    GList *group_;
+    for ( group_ = context->groups ; group_ != NULL ; group_ = g_list_next(group_) )
+        busy = _j4status_sensors_group_update(group_->data) || busy;
+
+    if ( busy )
+        context->stable_ticks = 0;
+    else if ( context->stable_ticks < STABLE_TICKS )
+        ++context->stable_ticks;
+
+    if ( context->stable_ticks < STABLE_TICKS )
+        return context->config.interval.fast;
+    return context->config.interval.slow;
+}
+
+static void _j4status_sensors_schedule(J4statusPluginContext *context, guint interval);
+
+static gboolean
+_j4status_sensors_timeout(gpointer user_data)
+{
+    J4statusPluginContext *context = user_data;
+
+    guint interval = _j4status_sensors_update(context);
+    if ( interval == context->interval )
+        return G_SOURCE_CONTINUE;
+
+    context->timeout_id = 0;
+    _j4status_sensors_schedule(context, interval);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_j4status_sensors_schedule(J4statusPluginContext *context, guint interval)
+{
+    if ( ( context->timeout_id > 0 ) && ( interval == context->interval ) )
+        return;
+
+    if ( context->timeout_id > 0 )
+        g_source_remove(context->timeout_id);
+    context->interval = interval;
+    context->timeout_id = g_timeout_add_seconds(interval, _j4status_sensors_timeout, context);
+}
+
+static gboolean
+_j4status_sensors_feature_crit_check(J4statusSensorsFeature *feature)
+{
+    if ( feature->subfeatures.alarm != NULL )
+    {
+        /* The alarm is a plain boolean, do not scale it */
+        gdouble alarm = -1;
+        if ( feature->fds.alarm >= 0 )
+        {
+            gchar buffer[8];
+            gssize r;
+            r = pread(feature->fds.alarm, buffer, sizeof(buffer) - 1, 0);
+            if ( r > 0 )
+            {
+                buffer[r] = '\0';
+                alarm = g_ascii_strtod(buffer, NULL);
+            }
+        }
+        else
+        {
+            double value;
+            if ( sensors_get_value(feature->chip, feature->subfeatures.alarm->number, &value) == 0 )
+                alarm = value;
         }
+        if ( alarm >= 0 )
+            return ( alarm > 0 );
     }
 
+    if ( feature->readings.crit <= 0 )
+        return FALSE;
+    feature->readings.input = _j4status_sensors_feature_read_value(feature, feature->subfeatures.input, feature->fds.input);
+    return ( feature->readings.input > feature->readings.crit );
+}
+
+static void
+_j4status_sensors_feature_crit_watch(J4statusSensorsFeature *feature)
+{
+    if ( ! _j4status_sensors_feature_crit_check(feature) )
+        return;
+
+    _j4status_sensors_feature_read(feature, TRUE);
+    _j4status_sensors_feature_temp_update(feature->context, feature);
+    if ( feature->group != NULL )
+        _j4status_sensors_group_update(feature->group);
+}
+
+static gboolean
+_j4status_sensors_crit_watch_timeout(gpointer user_data)
+{
+    J4statusPluginContext *context = user_data;
+
+    GList *feature_;
+    for ( feature_ = context->sections ; feature_ != NULL ; feature_ = g_list_next(feature_) )
+    {
+        J4statusSensorsFeature *feature = feature_->data;
+        if ( feature->subfeatures.crit != NULL )
+            _j4status_sensors_feature_crit_watch(feature);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+_j4status_sensors_crit_watch_alarm(gint fd, GIOCondition condition, gpointer user_data)
+{
+    /* Reading the attribute again re-arms the notification */
+    _j4status_sensors_feature_crit_watch(user_data);
+
     return G_SOURCE_CONTINUE;
 }
 
+static void
+_j4status_sensors_crit_watch_start(J4statusPluginContext *context)
+{
+    if ( context->crit_watch_id > 0 )
+        return;
+
+    GList *feature_;
+    for ( feature_ = context->sections ; feature_ != NULL ; feature_ = g_list_next(feature_) )
+    {
+        J4statusSensorsFeature *feature = feature_->data;
+        if ( feature->fds.alarm < 0 )
+            continue;
+
+        /*
+         * Drivers calling sysfs_notify() on their alarm attributes
+         * wake us up right away, others are caught by the timeout
+         */
+        _j4status_sensors_feature_crit_watch(feature);
+        feature->alarm_watch_id = g_unix_fd_add(feature->fds.alarm, G_IO_PRI | G_IO_ERR, _j4status_sensors_crit_watch_alarm, feature);
+    }
+
+    context->crit_watch_id = g_timeout_add_seconds(CRIT_WATCH_INTERVAL, _j4status_sensors_crit_watch_timeout, context);
+}
+
+static void
+_j4status_sensors_crit_watch_stop(J4statusPluginContext *context)
+{
+    if ( context->crit_watch_id == 0 )
+        return;
+
+    GList *feature_;
+    for ( feature_ = context->sections ; feature_ != NULL ; feature_ = g_list_next(feature_) )
+    {
+        J4statusSensorsFeature *feature = feature_->data;
+        if ( feature->alarm_watch_id > 0 )
+            g_source_remove(feature->alarm_watch_id);
+        feature->alarm_watch_id = 0;
+    }
+
+    g_source_remove(context->crit_watch_id);
+    context->crit_watch_id = 0;
+}
+
 static void
 _j4status_sensors_feature_free(gpointer data)
 {
     J4statusSensorsFeature *feature = data;
 
-    j4status_section_free(feature->section);
+    if ( feature->fds.alarm >= 0 )
+        close(feature->fds.alarm);
+    if ( feature->fds.crit >= 0 )
+        close(feature->fds.crit);
+    if ( feature->fds.max >= 0 )
+        close(feature->fds.max);
+    if ( feature->fds.input >= 0 )
+        close(feature->fds.input);
+
+    if ( feature->section != NULL )
+        j4status_section_free(feature->section);
 
     g_free(feature);
 }
@@ -196,6 +706,66 @@ _j4status_sensors_get_feature_name(const sensors_chip_name *chip, const sensors_
     return name;
 }
 
+static J4statusSensorsGroup *
+_j4status_sensors_find_group(J4statusPluginContext *context, const gchar *name, sensors_feature_type type)
+{
+    GList *group_;
+    for ( group_ = context->groups ; group_ != NULL ; group_ = g_list_next(group_) )
+    {
+        J4statusSensorsGroup *group = group_->data;
+        if ( ( group->features->len > 0 ) && ( group->type != type ) )
+            continue;
+
+        gchar **member;
+        for ( member = group->members ; *member != NULL ; ++member )
+        {
+            if ( g_pattern_match_simple(*member, name) )
+                return group;
+        }
+    }
+    return NULL;
+}
+
+static void
+_j4status_sensors_feature_add(J4statusPluginContext *context, J4statusSensorsFeature *feature)
+{
+    if ( ( feature->section != NULL ) && ( ! j4status_section_insert(feature->section) ) )
+    {
+        _j4status_sensors_feature_free(feature);
+        return;
+    }
+
+    if ( feature->group != NULL )
+    {
+        feature->group->type = feature->feature->type;
+        g_ptr_array_add(feature->group->features, feature);
+    }
+    context->sections = g_list_prepend(context->sections, feature);
+}
+
+/* Features can override the hysteresis in their [Override] section */
+static gdouble
+_j4status_sensors_feature_get_hysteresis(const gchar *name, gdouble hysteresis)
+{
+    gchar group_name[strlen("Override sensors:") + strlen(name) + 1];
+    g_sprintf(group_name, "Override sensors:%s", name);
+
+    GKeyFile *key_file;
+    key_file = j4status_config_get_key_file(group_name);
+    if ( key_file == NULL )
+        return hysteresis;
+
+    GError *error = NULL;
+    gdouble value;
+    value = g_key_file_get_double(key_file, group_name, "Hysteresis", &error);
+    if ( error == NULL )
+        hysteresis = MAX(0, value);
+    g_clear_error(&error);
+    g_key_file_free(key_file);
+
+    return hysteresis;
+}
+
 static void
 _j4status_sensors_add_feature_fan(J4statusPluginContext *context, const sensors_chip_name *chip, const sensors_feature *feature)
 {
@@ -212,14 +782,32 @@ _j4status_sensors_add_feature_fan(J4statusPluginContext *context, const sensors_
 
     J4statusSensorsFeature *sensor_feature;
     sensor_feature = g_new0(J4statusSensorsFeature, 1);
-    sensor_feature->section = j4status_section_new(context->core);
+    sensor_feature->context = context;
+    sensor_feature->group = _j4status_sensors_find_group(context, name, feature->type);
+    if ( ( sensor_feature->group == NULL ) || sensor_feature->group->show_members )
+        sensor_feature->section = j4status_section_new(context->core);
     sensor_feature->chip = chip;
     sensor_feature->feature = feature;
     sensor_feature->subfeatures.input = input;
     sensor_feature->subfeatures.max = sensors_get_subfeature(chip, feature, SENSORS_SUBFEATURE_FAN_MAX);
+    sensor_feature->fds.input = _j4status_sensors_feature_open(context, chip, sensor_feature->subfeatures.input);
+    sensor_feature->fds.max = _j4status_sensors_feature_open(context, chip, sensor_feature->subfeatures.max);
+    sensor_feature->fds.crit = -1;
+    sensor_feature->fds.alarm = -1;
+    sensor_feature->scale = 1;
+    sensor_feature->hysteresis = _j4status_sensors_feature_get_hysteresis(name, context->config.hysteresis.fan);
+    sensor_feature->readings.max = -1;
+    sensor_feature->readings.crit = -1;
+    sensor_feature->smoothed = NAN;
     sensor_feature->values.current = -1;
     sensor_feature->values.high = -1;
 
+    if ( sensor_feature->section == NULL )
+    {
+        _j4status_sensors_feature_add(context, sensor_feature);
+        return;
+    }
+
     char *label;
     label = sensors_get_label(chip, feature);
 
@@ -237,10 +825,7 @@ _j4status_sensors_add_feature_fan(J4statusPluginContext *context, const sensors_
 
     free(label);
 
-    if ( j4status_section_insert(sensor_feature->section) )
-        context->sections = g_list_prepend(context->sections, sensor_feature);
-    else
-        _j4status_sensors_feature_free(sensor_feature);
+    _j4status_sensors_feature_add(context, sensor_feature);
 }
 
 static void
@@ -259,16 +844,42 @@ _j4status_sensors_add_feature_temp(J4statusPluginContext *context, const sensors
 
     J4statusSensorsFeature *sensor_feature;
     sensor_feature = g_new0(J4statusSensorsFeature, 1);
-    sensor_feature->section = j4status_section_new(context->core);
+    sensor_feature->context = context;
+    sensor_feature->group = _j4status_sensors_find_group(context, name, feature->type);
+    if ( ( sensor_feature->group == NULL ) || sensor_feature->group->show_members )
+        sensor_feature->section = j4status_section_new(context->core);
     sensor_feature->chip = chip;
     sensor_feature->feature = feature;
     sensor_feature->subfeatures.input = input;
     sensor_feature->subfeatures.max = sensors_get_subfeature(chip, feature, SENSORS_SUBFEATURE_TEMP_MAX);
     sensor_feature->subfeatures.crit = sensors_get_subfeature(chip, feature, SENSORS_SUBFEATURE_TEMP_CRIT);
+    sensor_feature->fds.input = _j4status_sensors_feature_open(context, chip, sensor_feature->subfeatures.input);
+    sensor_feature->fds.max = _j4status_sensors_feature_open(context, chip, sensor_feature->subfeatures.max);
+    sensor_feature->fds.crit = _j4status_sensors_feature_open(context, chip, sensor_feature->subfeatures.crit);
+    if ( sensor_feature->subfeatures.crit != NULL )
+    {
+        sensor_feature->subfeatures.alarm = sensors_get_subfeature(chip, feature, SENSORS_SUBFEATURE_TEMP_CRIT_ALARM);
+        /* Always opened, we need it to poll for notifications */
+        sensor_feature->fds.alarm = _j4status_sensors_feature_open_attribute(chip, sensor_feature->subfeatures.alarm);
+    }
+    else
+        sensor_feature->fds.alarm = -1;
+    /* hwmon exposes millidegrees */
+    sensor_feature->scale = 1000;
+    sensor_feature->hysteresis = _j4status_sensors_feature_get_hysteresis(name, context->config.hysteresis.temp);
+    sensor_feature->readings.max = -1;
+    sensor_feature->readings.crit = -1;
+    sensor_feature->smoothed = NAN;
     sensor_feature->values.current = -1;
     sensor_feature->values.high = -1;
     sensor_feature->values.crit = -1;
 
+    if ( sensor_feature->section == NULL )
+    {
+        _j4status_sensors_feature_add(context, sensor_feature);
+        return;
+    }
+
     char *label;
     label = sensors_get_label(chip, feature);
 
@@ -290,10 +901,7 @@ _j4status_sensors_add_feature_temp(J4statusPluginContext *context, const sensors
 
     free(label);
 
-    if ( j4status_section_insert(sensor_feature->section) )
-        context->sections = g_list_prepend(context->sections, sensor_feature);
-    else
-        _j4status_sensors_feature_free(sensor_feature);
+    _j4status_sensors_feature_add(context, sensor_feature);
 }
 
 static void
@@ -322,14 +930,124 @@ _j4status_sensors_add_sensors(J4statusPluginContext *context, const sensors_chip
     }
 }
 
+static void
+_j4status_sensors_group_free(gpointer data)
+{
+    J4statusSensorsGroup *group = data;
+
+    if ( group->section != NULL )
+        j4status_section_free(group->section);
+
+    g_ptr_array_free(group->features, TRUE);
+    g_strfreev(group->members);
+    g_free(group->name);
+
+    g_free(group);
+}
+
+static J4statusSensorsGroup *
+_j4status_sensors_group_new(J4statusPluginContext *context, const gchar *name)
+{
+    gchar group_name[strlen("Sensors Group ") + strlen(name) + 1];
+    g_sprintf(group_name, "Sensors Group %s", name);
+
+    GKeyFile *key_file;
+    key_file = j4status_config_get_key_file(group_name);
+    if ( key_file == NULL )
+    {
+        g_warning("Missing configuration for sensors group '%s', skipping", name);
+        return NULL;
+    }
+
+    gchar **members;
+    members = g_key_file_get_string_list(key_file, group_name, "Members", NULL, NULL);
+    if ( members == NULL )
+    {
+        g_warning("No members in sensors group '%s', skipping", name);
+        g_key_file_free(key_file);
+        return NULL;
+    }
+
+    J4statusSensorsGroup *group;
+    group = g_new0(J4statusSensorsGroup, 1);
+    group->context = context;
+    group->name = g_key_file_get_string(key_file, group_name, "Label", NULL);
+    if ( group->name == NULL )
+        group->name = g_strdup(name);
+    group->members = members;
+    group->show_members = g_key_file_get_boolean(key_file, group_name, "ShowMembers", NULL);
+    group->features = g_ptr_array_new();
+    group->values.current = -1;
+
+    guint64 reduce = REDUCE_MAX;
+    j4status_config_key_file_get_enum(key_file, group_name, "Reduce", _j4status_sensors_reduce, G_N_ELEMENTS(_j4status_sensors_reduce), &reduce);
+    group->reduce = reduce;
+
+    GError *error = NULL;
+    group->hysteresis = g_key_file_get_double(key_file, group_name, "Hysteresis", &error);
+    if ( error != NULL )
+        group->hysteresis = -1;
+    else
+        group->hysteresis = MAX(0, group->hysteresis);
+    g_clear_error(&error);
+
+    g_key_file_free(key_file);
+
+    group->section = j4status_section_new(context->core);
+    j4status_section_set_name(group->section, "sensors");
+    j4status_section_set_instance(group->section, name);
+    j4status_section_set_label(group->section, group->name);
+
+    return group;
+}
+
+static gboolean
+_j4status_sensors_group_insert(J4statusPluginContext *context, J4statusSensorsGroup *group)
+{
+    if ( group->features->len == 0 )
+    {
+        g_warning("No sensor matched in sensors group '%s', skipping", group->name);
+        return FALSE;
+    }
+
+    gint64 max_width;
+    if ( group->type == SENSORS_FEATURE_FAN )
+    {
+        if ( group->hysteresis < 0 )
+            group->hysteresis = context->config.hysteresis.fan;
+        max_width = strlen("10000rpm");
+    }
+    else
+    {
+        if ( group->hysteresis < 0 )
+            group->hysteresis = context->config.hysteresis.temp;
+        max_width = strlen("+100.0*C");
+    }
+    j4status_section_set_max_width(group->section, -max_width);
+
+    if ( ! j4status_section_insert(group->section) )
+    {
+        j4status_section_free(group->section);
+        group->section = NULL;
+    }
+
+    return TRUE;
+}
+
 static void _j4status_sensors_uninit(J4statusPluginContext *context);
 
 static J4statusPluginContext *
 _j4status_sensors_init(J4statusCoreInterface *core)
 {
     gchar **sensors = NULL;
+    gchar **groups = NULL;
     gboolean show_details = FALSE;
+    gboolean fast_read = FALSE;
+    gdouble smoothing = 0;
+    gdouble temp_hysteresis = 0;
+    gdouble fan_hysteresis = 0;
     guint64 interval = 0;
+    guint64 slow_interval = 0;
 
     if ( sensors_init(NULL) != 0 )
         return NULL;
@@ -339,8 +1057,14 @@ _j4status_sensors_init(J4statusCoreInterface *core)
     if ( key_file != NULL )
     {
         sensors = g_key_file_get_string_list(key_file, "Sensors", "Sensors", NULL, NULL);
+        groups = g_key_file_get_string_list(key_file, "Sensors", "Groups", NULL, NULL);
         show_details = g_key_file_get_boolean(key_file, "Sensors", "ShowDetails", NULL);
+        fast_read = g_key_file_get_boolean(key_file, "Sensors", "FastRead", NULL);
+        smoothing = g_key_file_get_double(key_file, "Sensors", "Smoothing", NULL);
+        temp_hysteresis = g_key_file_get_double(key_file, "Sensors", "TemperatureHysteresis", NULL);
+        fan_hysteresis = g_key_file_get_double(key_file, "Sensors", "FanHysteresis", NULL);
         interval = g_key_file_get_uint64(key_file, "Sensors", "Interval", NULL);
+        slow_interval = g_key_file_get_uint64(key_file, "Sensors", "SlowInterval", NULL);
         g_key_file_free(key_file);
     }
 
@@ -349,7 +1073,25 @@ _j4status_sensors_init(J4statusCoreInterface *core)
     context->core = core;
 
     context->config.show_details = show_details;
-
+    context->config.fast_read = fast_read;
+    context->config.smoothing = CLAMP(smoothing, 0, 0.99);
+    context->config.hysteresis.temp = MAX(0, temp_hysteresis);
+    context->config.hysteresis.fan = MAX(0, fan_hysteresis);
+    context->config.interval.fast = MAX(2, MIN(interval, G_MAXUINT));
+    context->config.interval.slow = MAX(context->config.interval.fast, MIN(slow_interval, G_MAXUINT));
+
+    if ( groups != NULL )
+    {
+        gchar **name;
+        for ( name = groups ; *name != NULL ; ++name )
+        {
+            J4statusSensorsGroup *group;
+            group = _j4status_sensors_group_new(context, *name);
+            if ( group != NULL )
+                context->groups = g_list_append(context->groups, group);
+        }
+        g_strfreev(groups);
+    }
 
     if ( sensors == NULL )
         _j4status_sensors_add_sensors(context, NULL);
@@ -367,6 +1109,18 @@ _j4status_sensors_init(J4statusCoreInterface *core)
     }
     g_strfreev(sensors);
 
+    GList *group_ = context->groups;
+    while ( group_ != NULL )
+    {
+        GList *next = g_list_next(group_);
+        if ( ! _j4status_sensors_group_insert(context, group_->data) )
+        {
+            _j4status_sensors_group_free(group_->data);
+            context->groups = g_list_delete_link(context->groups, group_);
+        }
+        group_ = next;
+    }
+
     if ( context->sections == NULL )
     {
         g_message("Missing configuration: No sensor to monitor, aborting");
@@ -374,15 +1128,18 @@ _j4status_sensors_init(J4statusCoreInterface *core)
         return NULL;
     }
 
-    g_timeout_add_seconds(MAX(2, interval), _j4status_sensors_update, context);
-
     return context;
 }
 
 static void
 _j4status_sensors_uninit(J4statusPluginContext *context)
 {
+    _j4status_sensors_crit_watch_stop(context);
+    if ( context->timeout_id > 0 )
+        g_source_remove(context->timeout_id);
+
     g_list_free_full(context->sections, _j4status_sensors_feature_free);
+    g_list_free_full(context->groups, _j4status_sensors_group_free);
 
     g_free(context);
 
@@ -392,14 +1149,23 @@ _j4status_sensors_uninit(J4statusPluginContext *context)
 static void
 _j4status_sensors_start(J4statusPluginContext *context)
 {
+    _j4status_sensors_crit_watch_stop(context);
+
     context->started = TRUE;
-    _j4status_sensors_update(context);
+    context->stable_ticks = 0;
+    _j4status_sensors_schedule(context, _j4status_sensors_update(context));
 }
 
 static void
 _j4status_sensors_stop(J4statusPluginContext *context)
 {
     context->started = FALSE;
+
+    if ( context->timeout_id > 0 )
+        g_source_remove(context->timeout_id);
+    context->timeout_id = 0;
+
+    _j4status_sensors_crit_watch_start(context);
 }
 
 J4STATUS_EXPORT void
@@ -0,0 +1,280 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __J4STATUS_J4STATUS_SHM_H__
+#define __J4STATUS_J4STATUS_SHM_H__
+
+/*
+ * Shared memory layout of the shm input plugin, and a header-only
+ * producer library
+ *
+ * The segment is a header followed by fixed-size slots. Each slot is
+ * protected by a sequence lock: the sequence is odd while the producer
+ * writes, and the plugin only accepts a copy if the sequence was even
+ * and did not move while copying. Producers never do any syscall
+ * once the segment is mapped.
+ *
+ * A slot must only be written by one producer at a time. Each slot
+ * records the pid of its producer, and a slot whose producer died is
+ * reclaimed by the next producer needing one. The plugin never writes
+ * to the segment once it is created.
+ *
+ * The plugin never resizes a file in use: if it needs another layout,
+ * it renames a new file over the old one, and producers must reopen it.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define J4STATUS_SHM_MAGIC 0x4853344a /* "J4SH" */
+#define J4STATUS_SHM_VERSION 1
+#define J4STATUS_SHM_ID_SIZE 32
+#define J4STATUS_SHM_VALUE_SIZE 208
+
+/* Same values as J4statusState */
+#define J4STATUS_SHM_STATE_NO_STATE    0
+#define J4STATUS_SHM_STATE_UNAVAILABLE 1
+#define J4STATUS_SHM_STATE_BAD         2
+#define J4STATUS_SHM_STATE_AVERAGE     3
+#define J4STATUS_SHM_STATE_GOOD        4
+#define J4STATUS_SHM_STATE_URGENT      (1u << 31)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint8_t reserved[48];
+} J4statusShmHeader;
+
+typedef struct {
+    uint32_t claimed;
+    uint32_t sequence;
+    uint32_t state;
+    /* pid of the producer that claimed the slot */
+    uint32_t owner;
+    char id[J4STATUS_SHM_ID_SIZE];
+    char value[J4STATUS_SHM_VALUE_SIZE];
+} J4statusShmSlot;
+
+typedef struct {
+    J4statusShmHeader *header;
+    J4statusShmSlot *slots;
+    /* Checked against the mapping size, do not trust the header one */
+    uint32_t slot_count;
+    size_t size;
+} J4statusShm;
+
+static inline size_t
+j4status_shm_size(uint32_t slot_count)
+{
+    return sizeof(J4statusShmHeader) + (size_t) slot_count * sizeof(J4statusShmSlot);
+}
+
+/* path may be NULL for the default $XDG_RUNTIME_DIR/j4status/shm */
+static inline int
+j4status_shm_open(J4statusShm *shm, const char *path)
+{
+    char default_path[PATH_MAX];
+    if ( path == NULL )
+    {
+        const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+        if ( runtime_dir == NULL )
+        {
+            errno = ENOENT;
+            return -1;
+        }
+        snprintf(default_path, sizeof(default_path), "%s/j4status/shm", runtime_dir);
+        path = default_path;
+    }
+
+    int fd;
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if ( fd < 0 )
+        return -1;
+
+    struct stat st;
+    if ( fstat(fd, &st) < 0 )
+    {
+        close(fd);
+        return -1;
+    }
+    if ( (size_t) st.st_size < sizeof(J4statusShmHeader) )
+    {
+        close(fd);
+        errno = EPROTO;
+        return -1;
+    }
+
+    void *map;
+    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if ( map == MAP_FAILED )
+        return -1;
+
+    J4statusShmHeader *header = map;
+    if ( ( __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != J4STATUS_SHM_MAGIC ) || ( header->version != J4STATUS_SHM_VERSION ) || ( header->slot_size != sizeof(J4statusShmSlot) ) || ( j4status_shm_size(header->slot_count) > (size_t) st.st_size ) )
+    {
+        munmap(map, st.st_size);
+        errno = EPROTO;
+        return -1;
+    }
+
+    shm->header = header;
+    shm->slots = (J4statusShmSlot *) ( header + 1 );
+    shm->slot_count = header->slot_count;
+    shm->size = st.st_size;
+    return 0;
+}
+
+static inline void
+j4status_shm_close(J4statusShm *shm)
+{
+    munmap(shm->header, shm->size);
+    shm->header = NULL;
+    shm->slots = NULL;
+    shm->slot_count = 0;
+    shm->size = 0;
+}
+
+static inline void
+j4status_shm_slot_write_begin(J4statusShmSlot *slot)
+{
+    uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void
+j4status_shm_slot_write_end(J4statusShmSlot *slot)
+{
+    uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELEASE);
+}
+
+static inline int
+j4status_shm_slot_owner_is_dead(J4statusShmSlot *slot)
+{
+    uint32_t owner = __atomic_load_n(&slot->owner, __ATOMIC_ACQUIRE);
+    return ( owner != 0 ) && ( kill((pid_t) owner, 0) < 0 ) && ( errno == ESRCH );
+}
+
+/* Takes over the slot of a dead producer */
+static inline int
+j4status_shm_slot_reclaim(J4statusShmSlot *slot)
+{
+    uint32_t owner = __atomic_load_n(&slot->owner, __ATOMIC_ACQUIRE);
+    if ( ( ! __atomic_load_n(&slot->claimed, __ATOMIC_ACQUIRE) ) || ( ! j4status_shm_slot_owner_is_dead(slot) ) )
+        return 0;
+    if ( ! __atomic_compare_exchange_n(&slot->owner, &owner, (uint32_t) getpid(), 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) )
+        return 0;
+
+    /* It may have died mid-write, finish it so the sequence is even */
+    uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    if ( sequence & 1 )
+        __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/* Finds the slot for id, claiming a free one if needed */
+static inline J4statusShmSlot *
+j4status_shm_get_slot(J4statusShm *shm, const char *id)
+{
+    size_t length = strlen(id);
+    if ( ( length == 0 ) || ( length >= J4STATUS_SHM_ID_SIZE ) )
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    uint32_t i;
+    for ( i = 0 ; i < shm->slot_count ; ++i )
+    {
+        J4statusShmSlot *slot = &shm->slots[i];
+        if ( __atomic_load_n(&slot->claimed, __ATOMIC_ACQUIRE) && ( strncmp(slot->id, id, J4STATUS_SHM_ID_SIZE) == 0 ) )
+            return slot;
+    }
+
+    for ( i = 0 ; i < shm->slot_count ; ++i )
+    {
+        J4statusShmSlot *slot = &shm->slots[i];
+        uint32_t expected = 0;
+        if ( __atomic_compare_exchange_n(&slot->claimed, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) )
+            __atomic_store_n(&slot->owner, (uint32_t) getpid(), __ATOMIC_RELEASE);
+        else if ( ! j4status_shm_slot_reclaim(slot) )
+            continue;
+
+        j4status_shm_slot_write_begin(slot);
+        memset(slot->id, 0, J4STATUS_SHM_ID_SIZE);
+        memcpy(slot->id, id, length);
+        slot->value[0] = '\0';
+        slot->state = J4STATUS_SHM_STATE_NO_STATE;
+        j4status_shm_slot_write_end(slot);
+        return slot;
+    }
+
+    errno = ENOSPC;
+    return NULL;
+}
+
+static inline void
+j4status_shm_slot_set(J4statusShmSlot *slot, uint32_t state, const char *value)
+{
+    size_t length = strlen(value);
+    if ( length >= J4STATUS_SHM_VALUE_SIZE )
+    {
+        length = J4STATUS_SHM_VALUE_SIZE - 1;
+        /* Do not split a UTF-8 character */
+        while ( ( length > 0 ) && ( ( (unsigned char) value[length] & 0xc0 ) == 0x80 ) )
+            --length;
+    }
+
+    j4status_shm_slot_write_begin(slot);
+    memcpy(slot->value, value, length);
+    slot->value[length] = '\0';
+    slot->state = state;
+    j4status_shm_slot_write_end(slot);
+}
+
+/* Removes the section and frees the slot for other producers */
+static inline void
+j4status_shm_slot_release(J4statusShmSlot *slot)
+{
+    j4status_shm_slot_write_begin(slot);
+    slot->id[0] = '\0';
+    slot->value[0] = '\0';
+    slot->state = J4STATUS_SHM_STATE_NO_STATE;
+    j4status_shm_slot_write_end(slot);
+    __atomic_store_n(&slot->owner, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&slot->claimed, 0, __ATOMIC_RELEASE);
+}
+
+#endif /* __J4STATUS_J4STATUS_SHM_H__ */
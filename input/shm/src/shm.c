@@ -0,0 +1,373 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+
+#include "j4status-plugin-input.h"
+#include "j4status-shm.h"
+
+#define DEFAULT_SLOTS 64
+#define DEFAULT_INTERVAL 100
+/* Odd, so it never matches a stable sequence */
+#define SEQUENCE_UNSEEN G_MAXUINT32
+/* A slot mid-write for that many scans is checked for a dead producer */
+#define STALE_SCANS 50
+
+G_STATIC_ASSERT(J4STATUS_SHM_STATE_GOOD == J4STATUS_STATE_GOOD);
+G_STATIC_ASSERT(J4STATUS_SHM_STATE_URGENT == (guint32) J4STATUS_STATE_URGENT);
+G_STATIC_ASSERT(sizeof(J4statusShmHeader) == 64);
+G_STATIC_ASSERT(sizeof(J4statusShmSlot) == 256);
+
+typedef struct {
+    guint32 sequence;
+    guint32 odd_sequence;
+    guint stale_scans;
+    J4statusSection *section;
+    gchar id[J4STATUS_SHM_ID_SIZE];
+} J4statusShmReader;
+
+struct _J4statusPluginContext {
+    J4statusCoreInterface *core;
+    gchar *path;
+    J4statusShm shm;
+    J4statusShmReader *readers;
+    guint interval;
+    guint timeout_id;
+};
+
+static void
+_j4status_shm_reader_clear(J4statusShmReader *reader)
+{
+    if ( reader->section != NULL )
+        j4status_section_free(reader->section);
+    reader->section = NULL;
+    reader->id[0] = '\0';
+}
+
+static void
+_j4status_shm_slot_update(J4statusPluginContext *context, guint32 i)
+{
+    J4statusShmSlot *slot = &context->shm.slots[i];
+    J4statusShmReader *reader = &context->readers[i];
+
+    guint32 sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    if ( sequence & 1 )
+    {
+        if ( sequence != reader->odd_sequence )
+        {
+            reader->odd_sequence = sequence;
+            reader->stale_scans = 0;
+        }
+        else if ( ( ++reader->stale_scans >= STALE_SCANS ) && j4status_shm_slot_owner_is_dead(slot) )
+            /*
+             * The producer died between write_begin and write_end
+             * We never write to the segment, the next producer
+             * needing a slot will reclaim it
+             */
+            _j4status_shm_reader_clear(reader);
+        return;
+    }
+    reader->stale_scans = 0;
+    if ( sequence == reader->sequence )
+        return;
+
+    guint32 claimed = slot->claimed;
+    guint32 state = slot->state;
+    gchar id[J4STATUS_SHM_ID_SIZE];
+    gchar value[J4STATUS_SHM_VALUE_SIZE];
+    memcpy(id, slot->id, J4STATUS_SHM_ID_SIZE);
+    memcpy(value, slot->value, J4STATUS_SHM_VALUE_SIZE);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if ( __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != sequence )
+        /* Torn read, we will catch it on the next scan */
+        return;
+    reader->sequence = sequence;
+
+    id[J4STATUS_SHM_ID_SIZE - 1] = '\0';
+    value[J4STATUS_SHM_VALUE_SIZE - 1] = '\0';
+
+    if ( ( ! claimed ) || ( id[0] == '\0' ) || ( ! g_utf8_validate(id, -1, NULL) ) )
+    {
+        _j4status_shm_reader_clear(reader);
+        return;
+    }
+
+    /* Producers are untrusted, outputs index tables with the state */
+    if ( ( state & ~J4STATUS_SHM_STATE_URGENT ) >= _J4STATUS_STATE_SIZE )
+        state = J4STATUS_SHM_STATE_NO_STATE;
+    if ( ! g_utf8_validate(value, -1, NULL) )
+        return;
+
+    if ( ( reader->section != NULL ) && ( strcmp(reader->id, id) != 0 ) )
+        /* The slot was reused by another producer */
+        _j4status_shm_reader_clear(reader);
+
+    if ( reader->section == NULL )
+    {
+        J4statusSection *section;
+        section = j4status_section_new(context->core);
+        j4status_section_set_name(section, "shm");
+        j4status_section_set_instance(section, id);
+        if ( ! j4status_section_insert(section) )
+        {
+            j4status_section_free(section);
+            return;
+        }
+        reader->section = section;
+        strcpy(reader->id, id);
+    }
+
+    j4status_section_set_state(reader->section, state);
+    j4status_section_set_value(reader->section, ( value[0] == '\0' ) ? NULL : g_strdup(value));
+}
+
+static gboolean
+_j4status_shm_scan(gpointer user_data)
+{
+    J4statusPluginContext *context = user_data;
+
+    guint32 i;
+    for ( i = 0 ; i < context->shm.slot_count ; ++i )
+        _j4status_shm_slot_update(context, i);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static J4statusShmHeader *
+_j4status_shm_map_fd(J4statusPluginContext *context, gint fd, gsize size)
+{
+    gpointer map;
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if ( map == MAP_FAILED )
+    {
+        g_warning("Couldn't map shared memory file '%s': %s", context->path, g_strerror(errno));
+        return NULL;
+    }
+    return map;
+}
+
+/* Keep a compatible segment, producers may still have it mapped */
+static J4statusShmHeader *
+_j4status_shm_reuse(J4statusPluginContext *context, guint32 slots, gsize size)
+{
+    gint fd;
+    fd = open(context->path, O_RDWR | O_CLOEXEC);
+    if ( fd < 0 )
+        return NULL;
+
+    J4statusShmHeader *header = NULL;
+    struct stat st;
+    if ( ( fstat(fd, &st) == 0 ) && S_ISREG(st.st_mode) && ( (gsize) st.st_size == size ) )
+        header = _j4status_shm_map_fd(context, fd, size);
+    close(fd);
+
+    if ( header == NULL )
+        return NULL;
+
+    if ( ( header->magic != J4STATUS_SHM_MAGIC ) || ( header->version != J4STATUS_SHM_VERSION ) || ( header->slot_size != sizeof(J4statusShmSlot) ) || ( header->slot_count != slots ) )
+    {
+        munmap(header, size);
+        return NULL;
+    }
+
+    return header;
+}
+
+/*
+ * Never resize or wipe a file producers may have mapped,
+ * they would get SIGBUS: build a new one and rename it over
+ */
+static J4statusShmHeader *
+_j4status_shm_create(J4statusPluginContext *context, guint32 slots, gsize size)
+{
+    gchar *tmp;
+    tmp = g_strdup_printf("%s.XXXXXX", context->path);
+
+    gint fd;
+    fd = g_mkstemp_full(tmp, O_RDWR | O_CLOEXEC, 0600);
+    if ( fd < 0 )
+    {
+        g_warning("Couldn't create shared memory file '%s': %s", tmp, g_strerror(errno));
+        g_free(tmp);
+        return NULL;
+    }
+
+    J4statusShmHeader *header = NULL;
+    if ( ftruncate(fd, size) < 0 )
+        g_warning("Couldn't resize shared memory file '%s': %s", tmp, g_strerror(errno));
+    else
+        header = _j4status_shm_map_fd(context, fd, size);
+    close(fd);
+
+    if ( header == NULL )
+        goto fail;
+
+    header->version = J4STATUS_SHM_VERSION;
+    header->slot_count = slots;
+    header->slot_size = sizeof(J4statusShmSlot);
+    __atomic_store_n(&header->magic, J4STATUS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    if ( rename(tmp, context->path) < 0 )
+    {
+        g_warning("Couldn't replace shared memory file '%s': %s", context->path, g_strerror(errno));
+        munmap(header, size);
+        header = NULL;
+        goto fail;
+    }
+
+    g_free(tmp);
+    return header;
+
+fail:
+    unlink(tmp);
+    g_free(tmp);
+    return NULL;
+}
+
+static gboolean
+_j4status_shm_map(J4statusPluginContext *context, guint32 slots)
+{
+    gsize size = j4status_shm_size(slots);
+
+    J4statusShmHeader *header;
+    header = _j4status_shm_reuse(context, slots, size);
+    if ( header == NULL )
+        header = _j4status_shm_create(context, slots, size);
+    if ( header == NULL )
+        return FALSE;
+
+    context->shm.header = header;
+    context->shm.slots = (J4statusShmSlot *) ( header + 1 );
+    /* Producers can write the header, keep our own count */
+    context->shm.slot_count = slots;
+    context->shm.size = size;
+
+    return TRUE;
+}
+
+static J4statusPluginContext *
+_j4status_shm_init(J4statusCoreInterface *core)
+{
+    gchar *path = NULL;
+    guint64 slots = 0;
+    guint64 interval = 0;
+
+    GKeyFile *key_file;
+    key_file = j4status_config_get_key_file("SharedMemory");
+    if ( key_file != NULL )
+    {
+        path = g_key_file_get_string(key_file, "SharedMemory", "Path", NULL);
+        slots = g_key_file_get_uint64(key_file, "SharedMemory", "Slots", NULL);
+        interval = g_key_file_get_uint64(key_file, "SharedMemory", "Interval", NULL);
+        g_key_file_free(key_file);
+    }
+
+    if ( path == NULL )
+    {
+        gchar *dir;
+        dir = g_build_filename(g_get_user_runtime_dir(), PACKAGE_NAME, NULL);
+        if ( ( ! g_file_test(dir, G_FILE_TEST_IS_DIR) ) && ( g_mkdir_with_parents(dir, 0755) < 0 ) )
+        {
+            g_warning("Couldn't create the shared memory directory '%s': %s", dir, g_strerror(errno));
+            g_free(dir);
+            return NULL;
+        }
+        path = g_build_filename(dir, "shm", NULL);
+        g_free(dir);
+    }
+
+    J4statusPluginContext *context;
+    context = g_new0(J4statusPluginContext, 1);
+    context->core = core;
+    context->path = path;
+    context->interval = ( interval > 0 ) ? MIN(interval, G_MAXUINT) : DEFAULT_INTERVAL;
+
+    if ( slots == 0 )
+        slots = DEFAULT_SLOTS;
+    slots = MIN(slots, 4096);
+
+    if ( ! _j4status_shm_map(context, slots) )
+    {
+        g_free(context->path);
+        g_free(context);
+        return NULL;
+    }
+
+    context->readers = g_new0(J4statusShmReader, slots);
+    guint32 i;
+    for ( i = 0 ; i < slots ; ++i )
+        context->readers[i].sequence = SEQUENCE_UNSEEN;
+
+    return context;
+}
+
+static void
+_j4status_shm_uninit(J4statusPluginContext *context)
+{
+    if ( context->timeout_id > 0 )
+        g_source_remove(context->timeout_id);
+
+    guint32 i;
+    for ( i = 0 ; i < context->shm.slot_count ; ++i )
+        _j4status_shm_reader_clear(&context->readers[i]);
+    g_free(context->readers);
+
+    munmap(context->shm.header, context->shm.size);
+    g_free(context->path);
+
+    g_free(context);
+}
+
+static void
+_j4status_shm_start(J4statusPluginContext *context)
+{
+    _j4status_shm_scan(context);
+    context->timeout_id = g_timeout_add(context->interval, _j4status_shm_scan, context);
+}
+
+static void
+_j4status_shm_stop(J4statusPluginContext *context)
+{
+    if ( context->timeout_id > 0 )
+        g_source_remove(context->timeout_id);
+    context->timeout_id = 0;
+}
+
+J4STATUS_EXPORT void
+j4status_input_plugin(J4statusInputPluginInterface *interface)
+{
+    libj4status_input_plugin_interface_add_init_callback(interface, _j4status_shm_init);
+    libj4status_input_plugin_interface_add_uninit_callback(interface, _j4status_shm_uninit);
+
+    libj4status_input_plugin_interface_add_start_callback(interface, _j4status_shm_start);
+    libj4status_input_plugin_interface_add_stop_callback(interface, _j4status_shm_stop);
+}
@@ -37,128 +37,206 @@
 struct _J4statusPluginContext {
     J4statusCoreInterface *core;
     GList *sections;
+    GCancellable *cancellable;
     GDBusConnection *connection;
     gboolean started;
     GDBusProxy *manager;
+    gboolean single_subscription;
+    guint subscription_id;
+    /* Object path to a list of sections, aliases share a path */
+    GHashTable *units;
 };
 
 typedef struct {
     J4statusPluginContext *context;
     J4statusSection *section;
     gchar *unit_name;
+    /* Replaced on detach, so late replies are dropped */
+    GCancellable *cancellable;
+    gboolean attaching;
     GDBusProxy *unit;
+    gchar *object_path;
 } J4statusSystemdSection;
 
-static gboolean
-_j4status_systemd_dbus_call(GDBusProxy *proxy, const gchar *method, GError **error)
+static void
+_j4status_systemd_section_update(J4statusSystemdSection *section, gchar *status)
 {
-    GVariant *ret;
-    ret = g_dbus_proxy_call_sync(proxy, method, g_variant_new("()"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, error);
-    if ( ret == NULL )
-        return FALSE;
-    g_variant_get(ret, "()");
-    g_variant_unref(ret);
-    return TRUE;
+    J4statusState state;
+    if ( ( g_strcmp0(status, "active") == 0 ) || ( g_strcmp0(status, "reloading") == 0 ) )
+        state = J4STATUS_STATE_GOOD;
+    else if ( ( g_strcmp0(status, "failed") == 0 ) )
+        state = J4STATUS_STATE_BAD;
+    else
+        state = J4STATUS_STATE_NO_STATE;
+
+    j4status_section_set_state(section->section, state);
+    j4status_section_set_value(section->section, status);
 }
 
-static GDBusProxy *
-_j4status_systemd_dbus_get_unit(J4statusPluginContext *context, const gchar *unit_name)
+static void
+_j4status_systemd_unit_get_property_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
+    GError *error = NULL;
     GVariant *ret;
 
-    ret = g_dbus_proxy_call_sync(context->manager, "GetUnit", g_variant_new("(s)", unit_name), G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL);
+    ret = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
     if ( ret == NULL )
-        return NULL;
-
-    const gchar *unit_object_path;
-    g_variant_get(ret, "(&o)", &unit_object_path);
+    {
+        if ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
+            g_warning("Could get property %s . ActiveState: %s", SYSTEMD_UNIT_INTERFACE_NAME, error->message);
+        g_error_free(error);
+        return;
+    }
 
-    GError *error = NULL;
-    GDBusProxy *unit;
-    unit = g_dbus_proxy_new_sync(context->connection, G_DBUS_PROXY_FLAGS_GET_INVALIDATED_PROPERTIES, NULL, SYSTEMD_BUS_NAME, unit_object_path, SYSTEMD_UNIT_INTERFACE_NAME, NULL, &error);
-    if ( unit == NULL )
-        g_warning("Could not monitor unit %s: %s", unit_name, error->message);
-    g_clear_error(&error);
+    J4statusSystemdSection *section = user_data;
+    GVariant *val;
+    gchar *status;
 
+    g_variant_get(ret, "(v)", &val);
+    g_variant_get(val, "s", &status);
+    g_variant_unref(val);
     g_variant_unref(ret);
 
-    return unit;
+    _j4status_systemd_section_update(section, status);
 }
 
-static GVariant *
-_j4status_systemd_dbus_get_property(GDBusProxy *proxy, const gchar *property)
+static void
+_j4status_systemd_section_get_state(J4statusSystemdSection *section, const gchar *object_path)
 {
-    GError *error = NULL;
-    GVariant *ret, *val = NULL;
+    g_dbus_connection_call(section->context->connection, SYSTEMD_BUS_NAME, object_path, "org.freedesktop.DBus.Properties", "Get", g_variant_new("(ss)", SYSTEMD_UNIT_INTERFACE_NAME, "ActiveState"), G_VARIANT_TYPE("(v)"), G_DBUS_CALL_FLAGS_NONE, -1, section->cancellable, _j4status_systemd_unit_get_property_callback, section);
+}
+
+static void
+_j4status_systemd_unit_state_changed(GDBusProxy *gobject, GVariant *changed_properties, GStrv invalidated_properties, gpointer user_data)
+{
+    J4statusSystemdSection *section = user_data;
 
-    val = g_dbus_proxy_get_cached_property(proxy, property);
+    GVariant *val;
+    val = g_dbus_proxy_get_cached_property(section->unit, "ActiveState");
     if ( val == NULL )
     {
-        ret = g_dbus_proxy_call_sync(proxy, "org.freedesktop.DBus.Properties.Get", g_variant_new("(ss)", g_dbus_proxy_get_interface_name(proxy), property), G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
-        if ( ret == NULL )
-            g_warning("Could get property %s . %s: %s", g_dbus_proxy_get_interface_name(proxy), property, error->message);
-        else
-        {
-            g_variant_get(ret, "(v)", &val);
-            g_variant_unref(ret);
-        }
-        g_clear_error(&error);
+        _j4status_systemd_section_get_state(section, g_dbus_proxy_get_object_path(section->unit));
+        return;
     }
 
-    return val;
+    gchar *status;
+    g_variant_get(val, "s", &status);
+    g_variant_unref(val);
+
+    _j4status_systemd_section_update(section, status);
 }
 
-static gchar *
-_j4status_systemd_dbus_get_property_string(GDBusProxy *proxy, const gchar *property, const gchar *default_value)
+static void
+_j4status_systemd_unit_proxy_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
-    GVariant *ret;
+    GError *error = NULL;
+    GDBusProxy *unit;
 
-    ret = _j4status_systemd_dbus_get_property(proxy, property);
-    if ( ret == NULL )
-        return g_strdup(default_value);
+    unit = g_dbus_proxy_new_finish(res, &error);
+    if ( unit == NULL )
+    {
+        if ( g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
+        {
+            g_error_free(error);
+            return;
+        }
+    }
 
-    gchar *val;
-    g_variant_get(ret, "s", &val);
-    g_variant_unref(ret);
+    J4statusSystemdSection *section = user_data;
+    section->attaching = FALSE;
 
-    return val;
+    if ( unit == NULL )
+    {
+        g_warning("Could not monitor unit %s: %s", section->unit_name, error->message);
+        g_error_free(error);
+        return;
+    }
+
+    section->unit = unit;
+    g_signal_connect(section->unit, "g-properties-changed", G_CALLBACK(_j4status_systemd_unit_state_changed), section);
+    _j4status_systemd_unit_state_changed(section->unit, NULL, NULL, section);
 }
 
 static void
-_j4status_systemd_unit_state_changed(GDBusProxy *gobject, GVariant *changed_properties, GStrv invalidated_properties, gpointer user_data)
+_j4status_systemd_get_unit_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
+    GError *error = NULL;
+    GVariant *ret;
+
+    ret = g_dbus_proxy_call_finish(G_DBUS_PROXY(source_object), res, &error);
+    if ( ret == NULL )
+    {
+        if ( g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
+        {
+            g_error_free(error);
+            return;
+        }
+    }
+
     J4statusSystemdSection *section = user_data;
 
-    J4statusState state;
-    gchar *status;
-    status = _j4status_systemd_dbus_get_property_string(section->unit, "ActiveState", "Unknown");
-    if ( ( g_strcmp0(status, "active") == 0 ) || ( g_strcmp0(status, "reloading") == 0 ) )
-        state = J4STATUS_STATE_GOOD;
-    else if ( ( g_strcmp0(status, "failed") == 0 ) )
-        state = J4STATUS_STATE_BAD;
-    else
-        state = J4STATUS_STATE_NO_STATE;
+    if ( ret == NULL )
+    {
+        /* Not loaded, we will retry after the next reload */
+        section->attaching = FALSE;
+        g_error_free(error);
+        return;
+    }
 
-    j4status_section_set_state(section->section, state);
-    j4status_section_set_value(section->section, status);
+    const gchar *unit_object_path;
+    g_variant_get(ret, "(&o)", &unit_object_path);
+
+    if ( section->context->single_subscription )
+    {
+        /* No proxy, the shared subscription routes signals to us */
+        section->attaching = FALSE;
+        section->object_path = g_strdup(unit_object_path);
+        GList *sections;
+        sections = g_hash_table_lookup(section->context->units, section->object_path);
+        if ( sections == NULL )
+            g_hash_table_insert(section->context->units, g_strdup(section->object_path), g_list_prepend(NULL, section));
+        else
+            /* The head is unchanged, no need to insert it again */
+            sections = g_list_append(sections, section);
+        _j4status_systemd_section_get_state(section, section->object_path);
+        g_variant_unref(ret);
+        return;
+    }
+
+    g_dbus_proxy_new(section->context->connection, G_DBUS_PROXY_FLAGS_GET_INVALIDATED_PROPERTIES, NULL, SYSTEMD_BUS_NAME, unit_object_path, SYSTEMD_UNIT_INTERFACE_NAME, section->cancellable, _j4status_systemd_unit_proxy_callback, section);
+
+    g_variant_unref(ret);
 }
 
+/* All sections are attached concurrently */
 static void
 _j4status_systemd_section_attach_unit(gpointer data, gpointer user_data)
 {
     J4statusPluginContext *context = user_data;
     J4statusSystemdSection *section = data;
 
-    if ( section->unit != NULL )
+    if ( ( section->unit != NULL ) || ( section->object_path != NULL ) || section->attaching )
         return;
 
-    section->unit = _j4status_systemd_dbus_get_unit(context, section->unit_name);
+    section->attaching = TRUE;
+    g_dbus_proxy_call(context->manager, "GetUnit", g_variant_new("(s)", section->unit_name), G_DBUS_CALL_FLAGS_NONE, -1, section->cancellable, _j4status_systemd_get_unit_callback, section);
+}
 
-    if ( section->unit != NULL )
-    {
-        g_signal_connect(section->unit, "g-properties-changed", G_CALLBACK(_j4status_systemd_unit_state_changed), section);
-        _j4status_systemd_unit_state_changed(section->unit, NULL, NULL, section);
-    }
+static void
+_j4status_systemd_section_forget_object_path(J4statusSystemdSection *section)
+{
+    if ( section->object_path == NULL )
+        return;
+
+    GList *sections;
+    sections = g_hash_table_lookup(section->context->units, section->object_path);
+    sections = g_list_remove(sections, section);
+    if ( sections == NULL )
+        g_hash_table_remove(section->context->units, section->object_path);
+    else
+        g_hash_table_replace(section->context->units, g_strdup(section->object_path), sections);
+    g_free(section->object_path);
+    section->object_path = NULL;
 }
 
 static void
@@ -166,6 +244,12 @@ _j4status_systemd_section_detach_unit(gpointer data, gpointer user_data)
 {
     J4statusSystemdSection *section = data;
 
+    g_cancellable_cancel(section->cancellable);
+    g_object_unref(section->cancellable);
+    section->cancellable = g_cancellable_new();
+    section->attaching = FALSE;
+
+    _j4status_systemd_section_forget_object_path(section);
     if ( section->unit != NULL )
         g_object_unref(section->unit);
     section->unit = NULL;
@@ -189,11 +273,59 @@ _j4status_systemd_bus_signal(GDBusProxy *proxy, gchar *sender_name, gchar *signa
     }
 }
 
+static void
+_j4status_systemd_properties_changed(GDBusConnection *connection, const gchar *sender_name, const gchar *object_path, const gchar *interface_name, const gchar *signal_name, GVariant *parameters, gpointer user_data)
+{
+    J4statusPluginContext *context = user_data;
+
+    GList *sections;
+    sections = g_hash_table_lookup(context->units, object_path);
+    if ( sections == NULL )
+        return;
+
+    const gchar *interface;
+    GVariant *changed_properties;
+    const gchar **invalidated_properties;
+    g_variant_get(parameters, "(&s@a{sv}^a&s)", &interface, &changed_properties, &invalidated_properties);
+
+    gboolean invalidated = FALSE;
+    const gchar **property;
+    for ( property = invalidated_properties ; *property != NULL ; ++property )
+    {
+        if ( g_strcmp0(*property, "ActiveState") == 0 )
+        {
+            invalidated = TRUE;
+            break;
+        }
+    }
+
+    const gchar *status;
+    gboolean changed = g_variant_lookup(changed_properties, "ActiveState", "&s", &status);
+
+    GList *section_;
+    for ( section_ = sections ; section_ != NULL ; section_ = g_list_next(section_) )
+    {
+        J4statusSystemdSection *section = section_->data;
+        if ( changed )
+            _j4status_systemd_section_update(section, g_strdup(status));
+        else if ( invalidated )
+            _j4status_systemd_section_get_state(section, object_path);
+    }
+
+    g_variant_unref(changed_properties);
+    g_free(invalidated_properties);
+}
+
 static void
 _j4status_systemd_section_free(gpointer data)
 {
     J4statusSystemdSection *section = data;
 
+    g_cancellable_cancel(section->cancellable);
+    g_object_unref(section->cancellable);
+
+    _j4status_systemd_section_forget_object_path(section);
+
     if ( section->unit != NULL )
         g_object_unref(section->unit);
 
@@ -212,6 +344,7 @@ _j4status_systemd_section_new(J4statusPluginContext *context, gchar *unit_name)
     section = g_new0(J4statusSystemdSection, 1);
     section->context = context;
     section->unit_name = unit_name;
+    section->cancellable = g_cancellable_new();
     section->section = j4status_section_new(context->core);
 
     j4status_section_set_name(section->section, "systemd");
@@ -243,6 +376,64 @@ _j4status_systemd_section_new(J4statusPluginContext *context, gchar *unit_name)
 
 static void _j4status_systemd_uninit(J4statusPluginContext *context);
 
+static void
+_j4status_systemd_manager_call(J4statusPluginContext *context, const gchar *method)
+{
+    g_dbus_proxy_call(context->manager, method, g_variant_new("()"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+}
+
+static void
+_j4status_systemd_manager_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    GError *error = NULL;
+    GDBusProxy *manager;
+
+    manager = g_dbus_proxy_new_finish(res, &error);
+    if ( manager == NULL )
+    {
+        if ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
+            g_warning("Couldn't connect to systemd manager D-Bus interface: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    J4statusPluginContext *context = user_data;
+
+    context->manager = manager;
+    g_signal_connect(context->manager, "g-signal", G_CALLBACK(_j4status_systemd_bus_signal), context);
+
+    /* One match rule for all units, whatever their number */
+    if ( context->single_subscription )
+        context->subscription_id = g_dbus_connection_signal_subscribe(context->connection, SYSTEMD_BUS_NAME, "org.freedesktop.DBus.Properties", "PropertiesChanged", NULL, SYSTEMD_UNIT_INTERFACE_NAME, G_DBUS_SIGNAL_FLAGS_NONE, _j4status_systemd_properties_changed, context, NULL);
+
+    if ( context->started )
+    {
+        _j4status_systemd_manager_call(context, "Subscribe");
+        g_list_foreach(context->sections, _j4status_systemd_section_attach_unit, context);
+    }
+}
+
+static void
+_j4status_systemd_bus_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    GError *error = NULL;
+    GDBusConnection *connection;
+
+    connection = g_bus_get_finish(res, &error);
+    if ( connection == NULL )
+    {
+        if ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
+            g_warning("Couldn't connect to D-Bus: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    J4statusPluginContext *context = user_data;
+
+    context->connection = connection;
+    g_dbus_proxy_new(context->connection, G_DBUS_PROXY_FLAGS_NONE, NULL, SYSTEMD_BUS_NAME, SYSTEMD_OBJECT_PATH, SYSTEMD_MANAGER_INTERFACE_NAME, context->cancellable, _j4status_systemd_manager_callback, context);
+}
+
 J4statusPluginContext *
 _j4status_systemd_init(J4statusCoreInterface *core)
 {
@@ -262,34 +453,16 @@ _j4status_systemd_init(J4statusCoreInterface *core)
         g_key_file_free(key_file);
         return NULL;
     }
+    gboolean single_subscription = g_key_file_get_boolean(key_file, "systemd", "SingleSubscription", NULL);
     g_key_file_free(key_file);
 
-    GError *error = NULL;
-
-    GDBusConnection *connection = NULL;
-
-    connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
-    if ( connection == NULL )
-    {
-        g_warning("Couldn't connect to D-Bus: %s", error->message);
-        goto fail;
-    }
-
-    GDBusProxy *manager;
-    manager = g_dbus_proxy_new_sync(connection, G_DBUS_PROXY_FLAGS_NONE, NULL, SYSTEMD_BUS_NAME, SYSTEMD_OBJECT_PATH, SYSTEMD_MANAGER_INTERFACE_NAME, NULL, &error);
-    if ( manager == NULL )
-    {
-        g_warning("Couldn't connect to systemd manager D-Bus interface: %s", error->message);
-        goto fail;
-    }
-
     J4statusPluginContext *context = NULL;
 
     context = g_new0(J4statusPluginContext, 1);
     context->core = core;
-
-    context->connection = connection;
-    context->manager = manager;
+    context->cancellable = g_cancellable_new();
+    context->single_subscription = single_subscription;
+    context->units = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 
     gchar **unit;
     for ( unit = units ; *unit != NULL ; ++unit )
@@ -302,26 +475,28 @@ _j4status_systemd_init(J4statusCoreInterface *core)
         return NULL;
     }
 
-    g_signal_connect(context->manager, "g-signal", G_CALLBACK(_j4status_systemd_bus_signal), context);
+    /* Units are attached once the manager proxy is ready */
+    g_bus_get(G_BUS_TYPE_SYSTEM, context->cancellable, _j4status_systemd_bus_callback, context);
 
     return context;
-
-fail:
-    g_clear_error(&error);
-    if ( connection != NULL )
-        g_object_unref(connection);
-    g_strfreev(units);
-
-    return NULL;
 }
 
 static void
 _j4status_systemd_uninit(J4statusPluginContext *context)
 {
+    g_cancellable_cancel(context->cancellable);
+    g_object_unref(context->cancellable);
+
+    if ( context->subscription_id > 0 )
+        g_dbus_connection_signal_unsubscribe(context->connection, context->subscription_id);
+
     g_list_free_full(context->sections, _j4status_systemd_section_free);
+    g_hash_table_unref(context->units);
 
-    g_object_unref(context->manager);
-    g_object_unref(context->connection);
+    if ( context->manager != NULL )
+        g_object_unref(context->manager);
+    if ( context->connection != NULL )
+        g_object_unref(context->connection);
 
     g_free(context);
 }
@@ -330,7 +505,10 @@ static void
 _j4status_systemd_start(J4statusPluginContext *context)
 {
     context->started = TRUE;
-    _j4status_systemd_dbus_call(context->manager, "Subscribe", NULL);
+    if ( context->manager == NULL )
+        return;
+
+    _j4status_systemd_manager_call(context, "Subscribe");
     g_list_foreach(context->sections, _j4status_systemd_section_attach_unit, context);
 }
 
@@ -338,7 +516,10 @@ static void
 _j4status_systemd_stop(J4statusPluginContext *context)
 {
     context->started = FALSE;
-    _j4status_systemd_dbus_call(context->manager, "Unsubscribe", NULL);
+    if ( context->manager == NULL )
+        return;
+
+    _j4status_systemd_manager_call(context, "Unsubscribe");
     g_list_foreach(context->sections, _j4status_systemd_section_detach_unit, context);
 }
 
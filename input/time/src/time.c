@@ -23,9 +23,17 @@
 #include "config.h"
 
 #include <errno.h>
+#include <string.h>
+#ifdef HAVE_TIMERFD
+#include <unistd.h>
+#include <sys/timerfd.h>
+#endif /* HAVE_TIMERFD */
 
 #include <glib.h>
 #include <glib/gprintf.h>
+#ifdef HAVE_TIMERFD
+#include <glib-unix.h>
+#endif /* HAVE_TIMERFD */
 
 #include "j4status-plugin-input.h"
 
@@ -36,6 +44,10 @@ struct _J4statusPluginContext {
     guint64 interval;
     gchar *format;
     GList *sections;
+    guint64 period;
+#ifdef HAVE_TIMERFD
+    gint fd;
+#endif /* HAVE_TIMERFD */
     guint timeout_id;
 };
 
@@ -67,6 +79,98 @@ _j4status_time_update(gpointer user_data)
     return G_SOURCE_CONTINUE;
 }
 
+/*
+ * Finest unit the format needs, in seconds
+ * We never go coarser than a minute, since some timezones
+ * are not aligned on hours with UTC
+ */
+static guint64
+_j4status_time_format_get_period(const gchar *format)
+{
+    const gchar *c;
+    for ( c = format ; *c != '\0' ; ++c )
+    {
+        if ( *c != '%' )
+            continue;
+
+        /* Skip padding flags and modifiers */
+        do
+            ++c;
+        while ( ( *c != '\0' ) && ( strchr("_-0EO:", *c) != NULL ) );
+
+        switch ( *c )
+        {
+        case '\0':
+            return 60;
+        case 'c':
+        case 'f':
+        case 'r':
+        case 's':
+        case 'S':
+        case 'T':
+        case 'X':
+            return 1;
+        }
+    }
+
+    return 60;
+}
+
+#ifdef HAVE_TIMERFD
+static gboolean
+_j4status_time_timerfd_arm(J4statusPluginContext *context)
+{
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    struct itimerspec spec = {
+        .it_interval = { .tv_sec = context->period },
+        .it_value = { .tv_sec = now - ( now % context->period ) + context->period },
+    };
+
+    /* We want to know when the clock jumps, to refresh and realign */
+    if ( timerfd_settime(context->fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, NULL) < 0 )
+    {
+        g_warning("Couldn't arm timer: %s", g_strerror(errno));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+_j4status_time_timerfd_callback(gint fd, GIOCondition condition, gpointer user_data)
+{
+    J4statusPluginContext *context = user_data;
+    guint64 expirations;
+
+    if ( ( read(fd, &expirations, sizeof(expirations)) < 0 ) && ( errno == ECANCELED ) )
+        _j4status_time_timerfd_arm(context);
+
+    return _j4status_time_update(context);
+}
+#endif /* HAVE_TIMERFD */
+
+static void _j4status_time_schedule(J4statusPluginContext *context);
+
+static gboolean
+_j4status_time_timeout(gpointer user_data)
+{
+    J4statusPluginContext *context = user_data;
+
+    _j4status_time_update(context);
+    _j4status_time_schedule(context);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_j4status_time_schedule(J4statusPluginContext *context)
+{
+    gint64 now = g_get_real_time();
+    gint64 period = context->period * G_USEC_PER_SEC;
+
+    context->timeout_id = g_timeout_add(( period - ( now % period ) ) / 1000 + 1, _j4status_time_timeout, context);
+}
+
 static void
 _j4status_time_section_free(gpointer data)
 {
@@ -111,6 +215,9 @@ _j4status_time_init(J4statusCoreInterface *core)
 
     context = g_new0(J4statusPluginContext, 1);
     context->core = core;
+#ifdef HAVE_TIMERFD
+    context->fd = -1;
+#endif /* HAVE_TIMERFD */
 
     context->format = g_strdup("%F %T");
     gchar **timezones = NULL;
@@ -144,8 +251,6 @@ _j4status_time_init(J4statusCoreInterface *core)
 
         g_key_file_free(key_file);
     }
-    if ( context->interval < 1 )
-        context->interval = 1;
 
     if ( timezones == NULL )
         _j4status_time_section_new(context, NULL, NULL);
@@ -180,12 +285,32 @@ _j4status_time_init(J4statusCoreInterface *core)
         return NULL;
     }
 
+    context->period = 60;
+    GList *section_;
+    for ( section_ = context->sections ; section_ != NULL ; section_ = g_list_next(section_) )
+    {
+        J4statusTimeSection *section = section_->data;
+        context->period = MIN(context->period, _j4status_time_format_get_period(( section->format != NULL ) ? section->format : context->format));
+    }
+    context->period = MAX(context->period, context->interval);
+
+#ifdef HAVE_TIMERFD
+    context->fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if ( context->fd < 0 )
+        g_warning("Couldn't create timer, clock changes will not be caught: %s", g_strerror(errno));
+#endif /* HAVE_TIMERFD */
+
     return context;
 }
 
 static void
 _j4status_time_uninit(J4statusPluginContext *context)
 {
+#ifdef HAVE_TIMERFD
+    if ( context->fd >= 0 )
+        close(context->fd);
+#endif /* HAVE_TIMERFD */
+
     g_list_free_full(context->sections, _j4status_time_section_free);
 
     g_free(context->format);
@@ -197,7 +322,16 @@ static void
 _j4status_time_start(J4statusPluginContext *context)
 {
     _j4status_time_update(context);
-    context->timeout_id = g_timeout_add_seconds(context->interval, _j4status_time_update, context);
+
+#ifdef HAVE_TIMERFD
+    if ( ( context->fd >= 0 ) && _j4status_time_timerfd_arm(context) )
+    {
+        context->timeout_id = g_unix_fd_add(context->fd, G_IO_IN, _j4status_time_timerfd_callback, context);
+        return;
+    }
+#endif /* HAVE_TIMERFD */
+
+    _j4status_time_schedule(context);
 }
 
 static void
@@ -205,6 +339,14 @@ _j4status_time_stop(J4statusPluginContext *context)
 {
     g_source_remove(context->timeout_id);
     context->timeout_id = 0;
+
+#ifdef HAVE_TIMERFD
+    if ( context->fd >= 0 )
+    {
+        struct itimerspec spec = { .it_value = { .tv_sec = 0 } };
+        timerfd_settime(context->fd, 0, &spec, NULL);
+    }
+#endif /* HAVE_TIMERFD */
 }
 
 J4STATUS_EXPORT void
@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include <glib.h>
+#include <gio/gio.h>
 #include <upower.h>
 
 #include "j4status-plugin-input.h"
@@ -35,7 +36,8 @@ struct _J4statusPluginContext {
     J4statusCoreInterface *core;
     GList *sections;
     J4statusFormatString *format;
-    UpClient *up_client;
+    gboolean all_devices;
+    GCancellable *cancellable;
     gboolean started;
 };
 
@@ -43,8 +45,10 @@ typedef struct {
     J4statusPluginContext *context;
     GObject *device;
     J4statusSection *section;
+    guint update_id;
 } J4statusUpowerSection;
 
+
 typedef enum {
     TOKEN_STATUS,
     TOKEN_CHARGE,
@@ -92,13 +96,9 @@ _j4status_upower_format_callback(G_GNUC_UNUSED const gchar *token, guint64 value
 }
 
 static void
-#if UP_CHECK_VERSION(0,99,0)
-_j4status_upower_device_changed(GObject *device, GParamSpec *pspec, gpointer user_data)
-#else /* ! UP_CHECK_VERSION(0,99,0) */
-_j4status_upower_device_changed(GObject *device, gpointer user_data)
-#endif /* ! UP_CHECK_VERSION(0,99,0) */
+_j4status_upower_section_update(J4statusUpowerSection *section)
 {
-    J4statusUpowerSection *section = user_data;
+    GObject *device = section->device;
 
     UpDeviceState device_state;
     J4statusState state = J4STATUS_STATE_NO_STATE;
@@ -153,11 +153,44 @@ _j4status_upower_device_changed(GObject *device, gpointer user_data)
     j4status_section_set_value(section->section, value);
 }
 
+static gboolean
+_j4status_upower_section_update_idle(gpointer user_data)
+{
+    J4statusUpowerSection *section = user_data;
+
+    section->update_id = 0;
+    _j4status_upower_section_update(section);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * A single refresh notifies many properties,
+ * render once they are all in
+ */
+static void
+#if UP_CHECK_VERSION(0,99,0)
+_j4status_upower_device_changed(GObject *device, GParamSpec *pspec, gpointer user_data)
+#else /* ! UP_CHECK_VERSION(0,99,0) */
+_j4status_upower_device_changed(GObject *device, gpointer user_data)
+#endif /* ! UP_CHECK_VERSION(0,99,0) */
+{
+    J4statusUpowerSection *section = user_data;
+
+    if ( section->update_id == 0 )
+        section->update_id = g_idle_add(_j4status_upower_section_update_idle, section);
+}
+
 static void
 _j4status_upower_section_free(gpointer data)
 {
     J4statusUpowerSection *section = data;
 
+    if ( section->update_id > 0 )
+        g_source_remove(section->update_id);
+
+    g_signal_handlers_disconnect_by_data(section->device, section);
+
     j4status_section_free(section->section);
 
     g_object_unref(section->device);
@@ -165,21 +198,12 @@ _j4status_upower_section_free(gpointer data)
     g_free(section);
 }
 
-static void
-_j4status_upower_section_new(J4statusPluginContext *context, GObject *device, gboolean all_devices)
+static gboolean
+_j4status_upower_device_kind_get_info(UpDeviceKind kind, gboolean all_devices, const gchar **name_, const gchar **label_)
 {
-    UpDeviceKind kind;
-
-    g_object_get(device, "kind", &kind, NULL);
-
-    const gchar *path;
     const gchar *name = NULL;
-    const gchar *instance = NULL;
     const gchar *label = NULL;
 
-    path = up_device_get_object_path(UP_DEVICE(device));
-    instance = g_utf8_strrchr(path, -1, '/') + strlen("/") + strlen(up_device_kind_to_string(kind)) + strlen("_");
-
     switch ( kind )
     {
     case UP_DEVICE_KIND_BATTERY:
@@ -187,64 +211,128 @@ _j4status_upower_section_new(J4statusPluginContext *context, GObject *device, gb
     break;
     case UP_DEVICE_KIND_UPS:
         if ( ! all_devices )
-            return;
+            return FALSE;
         name = "upower-ups";
         label = "UPS";
     break;
     case UP_DEVICE_KIND_MONITOR:
         if ( ! all_devices )
-            return;
+            return FALSE;
         name = "upower-monitor";
         label = "Monitor";
     break;
     case UP_DEVICE_KIND_MOUSE:
         if ( ! all_devices )
-            return;
+            return FALSE;
         name = "upower-mouse";
         label = "Mouse";
     break;
     case UP_DEVICE_KIND_KEYBOARD:
         if ( ! all_devices )
-            return;
+            return FALSE;
         name = "upower-keyboard";
         label = "Keyboard";
     break;
     case UP_DEVICE_KIND_PDA:
         if ( ! all_devices )
-            return;
+            return FALSE;
         name = "upower-pda";
         label = "PDA";
     break;
     case UP_DEVICE_KIND_PHONE:
         if ( ! all_devices )
-            return;
+            return FALSE;
         name = "upower-phone";
         label = "Phone";
     break;
     case UP_DEVICE_KIND_MEDIA_PLAYER:
         if ( ! all_devices )
-            return;
+            return FALSE;
         name = "upower-media-player";
         label = "Media player";
     break;
     case UP_DEVICE_KIND_TABLET:
         if ( ! all_devices )
-            return;
+            return FALSE;
         name = "upower-tablet";
         label = "Tablet";
     break;
     case UP_DEVICE_KIND_COMPUTER:
         if ( ! all_devices )
-            return;
+            return FALSE;
         name = "upower-computer";
         label = "Computer";
     break;
     case UP_DEVICE_KIND_UNKNOWN:
     case UP_DEVICE_KIND_LINE_POWER:
     case UP_DEVICE_KIND_LAST: /* Size placeholder */
-        return;
+        return FALSE;
     }
 
+    if ( name_ != NULL )
+        *name_ = name;
+    if ( label_ != NULL )
+        *label_ = label;
+    return TRUE;
+}
+
+/*
+ * UPower names device objects after their kind, e.g. battery_BAT0
+ * It canonicalises the name, so media-player gives media_player_*
+ */
+static const gchar *
+_j4status_upower_device_path_get_instance(const gchar *path, UpDeviceKind kind)
+{
+    const gchar *base = strrchr(path, '/');
+    if ( base == NULL )
+        return NULL;
+    ++base;
+
+    const gchar *prefix = up_device_kind_to_string(kind);
+    gsize i;
+    for ( i = 0 ; prefix[i] != '\0' ; ++i )
+    {
+        gchar c = g_ascii_isalnum(prefix[i]) ? prefix[i] : '_';
+        if ( base[i] != c )
+            return NULL;
+    }
+    if ( base[i] != '_' )
+        return NULL;
+    return base + i + 1;
+}
+
+static gboolean
+_j4status_upower_device_path_is_shown(const gchar *path, gboolean all_devices)
+{
+    guint kind;
+    for ( kind = UP_DEVICE_KIND_UNKNOWN ; kind < UP_DEVICE_KIND_LAST ; ++kind )
+    {
+        if ( _j4status_upower_device_kind_get_info(kind, all_devices, NULL, NULL) && ( _j4status_upower_device_path_get_instance(path, kind) != NULL ) )
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void
+_j4status_upower_section_new(J4statusPluginContext *context, GObject *device)
+{
+    UpDeviceKind kind;
+
+    g_object_get(device, "kind", &kind, NULL);
+
+    const gchar *path;
+    const gchar *name = NULL;
+    const gchar *instance = NULL;
+    const gchar *label = NULL;
+
+    if ( ! _j4status_upower_device_kind_get_info(kind, context->all_devices, &name, &label) )
+        return;
+
+    path = up_device_get_object_path(UP_DEVICE(device));
+    instance = _j4status_upower_device_path_get_instance(path, kind);
+    if ( instance == NULL )
+        instance = g_utf8_strrchr(path, -1, '/') + strlen("/");
+
     J4statusUpowerSection *section;
     section = g_new0(J4statusUpowerSection, 1);
     section->context = context;
@@ -262,71 +350,137 @@ _j4status_upower_section_new(J4statusPluginContext *context, GObject *device, gb
 
 #if UP_CHECK_VERSION(0,99,0)
         g_signal_connect(device, "notify", G_CALLBACK(_j4status_upower_device_changed), section);
-        _j4status_upower_device_changed(device, NULL, section);
 #else /* ! UP_CHECK_VERSION(0,99,0) */
         g_signal_connect(device, "changed", G_CALLBACK(_j4status_upower_device_changed), section);
-        _j4status_upower_device_changed(device, section);
 #endif /* ! UP_CHECK_VERSION(0,99,0) */
+        _j4status_upower_section_update(section);
     }
     else
         _j4status_upower_section_free(section);
 }
 
-static void _j4status_upower_uninit(J4statusPluginContext *context);
-
-static J4statusPluginContext *
-_j4status_upower_init(J4statusCoreInterface *core)
+/*
+ * Listing devices and creating their proxies are blocking
+ * system bus calls, keep them off the main thread
+ * We only create proxies for the kinds we will show
+ * Device proxies dispatch to the global default main context
+ */
+static void
+_j4status_upower_enumerate_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
 {
-    J4statusPluginContext *context;
-    context = g_new0(J4statusPluginContext, 1);
-    context->core = core;
+    gboolean all_devices = GPOINTER_TO_INT(task_data);
+    GError *error = NULL;
 
-    context->up_client = up_client_new();
+    GDBusConnection *connection;
+    connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, cancellable, &error);
+    if ( connection == NULL )
+    {
+        g_task_return_error(task, error);
+        return;
+    }
 
-#if ! UP_CHECK_VERSION(0,99,0)
-    if ( ! up_client_enumerate_devices_sync(context->up_client, NULL, NULL) )
+    GVariant *ret;
+    ret = g_dbus_connection_call_sync(connection, "org.freedesktop.UPower", "/org/freedesktop/UPower", "org.freedesktop.UPower", "EnumerateDevices", NULL, G_VARIANT_TYPE("(ao)"), G_DBUS_CALL_FLAGS_NONE, -1, cancellable, &error);
+    g_object_unref(connection);
+    if ( ret == NULL )
     {
-        g_object_unref(context->up_client);
-        g_free(context);
-        return NULL;
+        g_task_return_error(task, error);
+        return;
     }
-#endif /* ! UP_CHECK_VERSION(0,99,0) */
 
-    gboolean all_devices = FALSE;
-    gchar *format = NULL;
+    GPtrArray *devices;
+    devices = g_ptr_array_new_with_free_func(g_object_unref);
 
-    GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("UPower");
-    if ( key_file != NULL )
+    GVariantIter *paths;
+    const gchar *path;
+    g_variant_get(ret, "(ao)", &paths);
+    while ( g_variant_iter_next(paths, "&o", &path) )
     {
-        all_devices = g_key_file_get_boolean(key_file, "UPower", "AllDevices", NULL);
-        format = g_key_file_get_string(key_file, "UPower", "Format", NULL);
-        g_key_file_free(key_file);
+        if ( ! _j4status_upower_device_path_is_shown(path, all_devices) )
+            continue;
+
+        UpDevice *device;
+        device = up_device_new();
+        if ( up_device_set_object_path_sync(device, path, cancellable, &error) )
+            g_ptr_array_add(devices, device);
+        else
+        {
+            g_debug("Couldn't get device %s: %s", path, error->message);
+            g_clear_error(&error);
+            g_object_unref(device);
+        }
+    }
+    g_variant_iter_free(paths);
+    g_variant_unref(ret);
+
+    if ( g_cancellable_set_error_if_cancelled(cancellable, &error) )
+    {
+        g_ptr_array_unref(devices);
+        g_task_return_error(task, error);
+        return;
     }
-    context->format = j4status_format_string_parse(format, _j4status_upower_format_tokens, G_N_ELEMENTS(_j4status_upower_format_tokens), J4STATUS_UPOWER_DEFAULT_FORMAT, NULL);
 
+    g_task_return_pointer(task, devices, (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+_j4status_upower_enumerate_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
     GPtrArray *devices;
-    guint i;
+    GError *error = NULL;
 
-    devices = up_client_get_devices(context->up_client);
+    devices = g_task_propagate_pointer(G_TASK(res), &error);
     if ( devices == NULL )
     {
-        g_warning("No devices to monitor, aborting");
-        g_object_unref(context->up_client);
-        g_free(context);
-        return NULL;
+        /* The context is already gone */
+        if ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
+            g_warning("Couldn't enumerate devices, no device to monitor: %s", error->message);
+        g_error_free(error);
+        return;
     }
+
+    J4statusPluginContext *context = user_data;
+
+    guint i;
     for ( i = 0 ; i < devices->len ; ++i )
-        _j4status_upower_section_new(context, g_ptr_array_index(devices, i), all_devices);
+        _j4status_upower_section_new(context, g_ptr_array_index(devices, i));
+
     g_ptr_array_unref(devices);
 
+    /*
+     * Init returned before we could know,
+     * so we stay loaded but idle
+     */
     if ( context->sections == NULL )
+        g_warning("No device to monitor%s", context->all_devices ? "" : " (only batteries are shown unless AllDevices is set)");
+}
+
+static J4statusPluginContext *
+_j4status_upower_init(J4statusCoreInterface *core)
+{
+    J4statusPluginContext *context;
+    context = g_new0(J4statusPluginContext, 1);
+    context->core = core;
+
+    gchar *format = NULL;
+
+    GKeyFile *key_file;
+    key_file = j4status_config_get_key_file("UPower");
+    if ( key_file != NULL )
     {
-        g_message("Missing configuration: No device to monitor, aborting");
-        _j4status_upower_uninit(context);
-        return NULL;
+        context->all_devices = g_key_file_get_boolean(key_file, "UPower", "AllDevices", NULL);
+        format = g_key_file_get_string(key_file, "UPower", "Format", NULL);
+        g_key_file_free(key_file);
     }
+    context->format = j4status_format_string_parse(format, _j4status_upower_format_tokens, G_N_ELEMENTS(_j4status_upower_format_tokens), J4STATUS_UPOWER_DEFAULT_FORMAT, NULL);
 
+    context->cancellable = g_cancellable_new();
+
+    GTask *task;
+    task = g_task_new(NULL, context->cancellable, _j4status_upower_enumerate_callback, context);
+    g_task_set_task_data(task, GINT_TO_POINTER(context->all_devices), NULL);
+    g_task_run_in_thread(task, _j4status_upower_enumerate_thread);
+    g_object_unref(task);
 
     return context;
 }
@@ -334,6 +488,9 @@ _j4status_upower_init(J4statusCoreInterface *core)
 static void
 _j4status_upower_uninit(J4statusPluginContext *context)
 {
+    g_cancellable_cancel(context->cancellable);
+    g_object_unref(context->cancellable);
+
     j4status_format_string_unref(context->format);
 
     g_list_free_full(context->sections, _j4status_upower_section_free);
@@ -70,4 +70,8 @@ const gchar *j4status_section_get_cache(const J4statusSection *section);
 void j4status_section_set_output_user_data(J4statusSection *section, gpointer user_data, GDestroyNotify notify);
 gpointer j4status_section_get_output_user_data(J4statusSection *section);
 
+/* Appends string as a quoted JSON string */
+void j4status_escape_json_append(GString *out, const gchar *string, gssize length);
+void j4status_escape_markup_append(GString *out, const gchar *string, gssize length);
+
 #endif /* __J4STATUS_J4STATUS_PLUGIN_OUTPUT_H__ */
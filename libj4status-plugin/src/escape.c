@@ -0,0 +1,275 @@
+/*
+ * libj4status-plugin - Library to implement a j4status plugin
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) ) && defined(__SSE2__)
+#define J4STATUS_ESCAPE_X86 1
+#include <immintrin.h>
+#endif /* __GNUC__ && x86 && __SSE2__ */
+
+#include "j4status-plugin-output.h"
+
+/*
+ * Each scanner returns the offset of the first byte needing escaping,
+ * or length if the whole run can be copied as-is
+ */
+typedef gsize (*J4statusEscapeScanFunc)(const guchar *string, gsize length);
+
+typedef struct {
+    J4statusEscapeScanFunc json;
+    J4statusEscapeScanFunc markup;
+} J4statusEscapeScanners;
+
+#define _j4status_escape_json_needed(c) ( ( (c) < 0x20 ) || ( (c) == '"' ) || ( (c) == '\\' ) )
+#define _j4status_escape_markup_needed(c) ( ( (c) == '&' ) || ( (c) == '<' ) || ( (c) == '>' ) || ( (c) == '\'' ) || ( (c) == '"' ) )
+
+static gsize
+_j4status_escape_json_scan_scalar(const guchar *string, gsize length)
+{
+    gsize i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        if ( _j4status_escape_json_needed(string[i]) )
+            break;
+    }
+    return i;
+}
+
+static gsize
+_j4status_escape_markup_scan_scalar(const guchar *string, gsize length)
+{
+    gsize i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        if ( _j4status_escape_markup_needed(string[i]) )
+            break;
+    }
+    return i;
+}
+
+#ifdef J4STATUS_ESCAPE_X86
+
+static gsize
+_j4status_escape_json_scan_sse2(const guchar *string, gsize length)
+{
+    const __m128i control = _mm_set1_epi8(0x1f);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    gsize i;
+
+    for ( i = 0 ; i + 16 <= length ; i += 16 )
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) ( string + i ));
+        /* Unsigned v <= 0x1f, UTF-8 bytes are left alone */
+        __m128i m = _mm_cmpeq_epi8(_mm_max_epu8(v, control), control);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, quote));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, backslash));
+        gint mask = _mm_movemask_epi8(m);
+        if ( mask != 0 )
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + _j4status_escape_json_scan_scalar(string + i, length - i);
+}
+
+static gsize
+_j4status_escape_markup_scan_sse2(const guchar *string, gsize length)
+{
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i apos = _mm_set1_epi8('\'');
+    const __m128i quot = _mm_set1_epi8('"');
+    gsize i;
+
+    for ( i = 0 ; i + 16 <= length ; i += 16 )
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) ( string + i ));
+        __m128i m = _mm_cmpeq_epi8(v, amp);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, lt));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, gt));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, apos));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, quot));
+        gint mask = _mm_movemask_epi8(m);
+        if ( mask != 0 )
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + _j4status_escape_markup_scan_scalar(string + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static gsize
+_j4status_escape_json_scan_avx2(const guchar *string, gsize length)
+{
+    const __m256i control = _mm256_set1_epi8(0x1f);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    gsize i;
+
+    for ( i = 0 ; i + 32 <= length ; i += 32 )
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) ( string + i ));
+        __m256i m = _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, quote));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, backslash));
+        guint32 mask = (guint32) _mm256_movemask_epi8(m);
+        if ( mask != 0 )
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + _j4status_escape_json_scan_sse2(string + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static gsize
+_j4status_escape_markup_scan_avx2(const guchar *string, gsize length)
+{
+    const __m256i amp = _mm256_set1_epi8('&');
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i apos = _mm256_set1_epi8('\'');
+    const __m256i quot = _mm256_set1_epi8('"');
+    gsize i;
+
+    for ( i = 0 ; i + 32 <= length ; i += 32 )
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) ( string + i ));
+        __m256i m = _mm256_cmpeq_epi8(v, amp);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, lt));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, gt));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, apos));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, quot));
+        guint32 mask = (guint32) _mm256_movemask_epi8(m);
+        if ( mask != 0 )
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + _j4status_escape_markup_scan_sse2(string + i, length - i);
+}
+
+#endif /* J4STATUS_ESCAPE_X86 */
+
+static const J4statusEscapeScanners *
+_j4status_escape_get_scanners(void)
+{
+    static J4statusEscapeScanners scanners = {
+        .json = _j4status_escape_json_scan_scalar,
+        .markup = _j4status_escape_markup_scan_scalar,
+    };
+    static gsize init = 0;
+
+    if ( g_once_init_enter(&init) )
+    {
+#ifdef J4STATUS_ESCAPE_X86
+        /* Setting J4STATUS_ESCAPE_NO_SIMD forces the scalar path, for comparison */
+        if ( g_getenv("J4STATUS_ESCAPE_NO_SIMD") == NULL )
+        {
+            if ( __builtin_cpu_supports("avx2") )
+            {
+                scanners.json = _j4status_escape_json_scan_avx2;
+                scanners.markup = _j4status_escape_markup_scan_avx2;
+            }
+            else
+            {
+                scanners.json = _j4status_escape_json_scan_sse2;
+                scanners.markup = _j4status_escape_markup_scan_sse2;
+            }
+        }
+#endif /* J4STATUS_ESCAPE_X86 */
+        g_once_init_leave(&init, 1);
+    }
+
+    return &scanners;
+}
+
+J4STATUS_EXPORT void
+j4status_escape_json_append(GString *out, const gchar *string, gssize length)
+{
+    g_return_if_fail(out != NULL);
+    g_return_if_fail(string != NULL);
+
+    J4statusEscapeScanFunc scan = _j4status_escape_get_scanners()->json;
+    const guchar *s = (const guchar *) string;
+    gsize l = ( length < 0 ) ? strlen(string) : (gsize) length;
+
+    g_string_append_c(out, '"');
+    while ( l > 0 )
+    {
+        gsize n = scan(s, l);
+        g_string_append_len(out, (const gchar *) s, n);
+        if ( n == l )
+            break;
+
+        guchar c = s[n];
+        switch ( c )
+        {
+        case '"':  g_string_append_len(out, "\\\"", 2); break;
+        case '\\': g_string_append_len(out, "\\\\", 2); break;
+        case '\b': g_string_append_len(out, "\\b", 2); break;
+        case '\f': g_string_append_len(out, "\\f", 2); break;
+        case '\n': g_string_append_len(out, "\\n", 2); break;
+        case '\r': g_string_append_len(out, "\\r", 2); break;
+        case '\t': g_string_append_len(out, "\\t", 2); break;
+        default:
+            g_string_append_printf(out, "\\u%04x", c);
+        }
+        s += n + 1;
+        l -= n + 1;
+    }
+    g_string_append_c(out, '"');
+}
+
+J4STATUS_EXPORT void
+j4status_escape_markup_append(GString *out, const gchar *string, gssize length)
+{
+    g_return_if_fail(out != NULL);
+    g_return_if_fail(string != NULL);
+
+    J4statusEscapeScanFunc scan = _j4status_escape_get_scanners()->markup;
+    const guchar *s = (const guchar *) string;
+    gsize l = ( length < 0 ) ? strlen(string) : (gsize) length;
+
+    while ( l > 0 )
+    {
+        gsize n = scan(s, l);
+        g_string_append_len(out, (const gchar *) s, n);
+        if ( n == l )
+            break;
+
+        switch ( s[n] )
+        {
+        case '&':  g_string_append_len(out, "&amp;", 5); break;
+        case '<':  g_string_append_len(out, "&lt;", 4); break;
+        case '>':  g_string_append_len(out, "&gt;", 4); break;
+        case '\'': g_string_append_len(out, "&apos;", 6); break;
+        case '"':  g_string_append_len(out, "&quot;", 6); break;
+        }
+        s += n + 1;
+        l -= n + 1;
+    }
+}
@@ -161,6 +161,7 @@ j4status_section_set_name(J4statusSection *self, const gchar *name)
     g_return_if_fail(! self->freeze);
     g_return_if_fail(name != NULL);
 
+    g_free(self->name);
     self->name = g_strdup(name);
 }
 
@@ -109,11 +109,32 @@ j4status_colour_parse_length(const gchar *colour, gint length)
     return j4status_colour_parse(string);
 }
 
-J4STATUS_EXPORT const gchar *
-j4status_colour_to_hex(J4statusColour colour)
+/*
+ * Strings are formatted in a small per-thread ring of buffers, so callers
+ * can hold a few of them at once, without any lock or unbounded cache
+ * Keep one with g_strdup() if you need it longer
+ */
+#define COLOUR_STRING_BUFFERS 4
+#define COLOUR_STRING_SIZE 64
+
+typedef struct {
+    guint next;
+    gchar buffers[COLOUR_STRING_BUFFERS][COLOUR_STRING_SIZE];
+} J4statusColourStrings;
+
+static GPrivate _j4status_colour_strings = G_PRIVATE_INIT(g_free);
+
+static const gchar *
+_j4status_colour_to_string(J4statusColour colour, gboolean rgba)
 {
-    if ( ! colour.set )
-        return NULL;
+    J4statusColourStrings *strings;
+
+    strings = g_private_get(&_j4status_colour_strings);
+    if ( strings == NULL )
+    {
+        strings = g_new0(J4statusColourStrings, 1);
+        g_private_set(&_j4status_colour_strings, strings);
+    }
 
     NkColour colour_ = {
         .red   = colour.red   / 255.,
@@ -122,21 +143,27 @@ j4status_colour_to_hex(J4statusColour colour)
         .alpha = colour.alpha / 255.,
     };
 
-    return nk_colour_to_hex(&colour_);
+    gchar *string = strings->buffers[strings->next];
+    strings->next = ( strings->next + 1 ) % COLOUR_STRING_BUFFERS;
+    g_strlcpy(string, rgba ? nk_colour_to_rgba(&colour_) : nk_colour_to_hex(&colour_), COLOUR_STRING_SIZE);
+
+    return string;
 }
 
 J4STATUS_EXPORT const gchar *
-j4status_colour_to_rgb(J4statusColour colour)
+j4status_colour_to_hex(J4statusColour colour)
 {
     if ( ! colour.set )
         return NULL;
 
-    NkColour colour_ = {
-        .red   = colour.red   / 255.,
-        .green = colour.green / 255.,
-        .blue  = colour.blue  / 255.,
-        .alpha = colour.alpha / 255.,
-    };
+    return _j4status_colour_to_string(colour, FALSE);
+}
+
+J4STATUS_EXPORT const gchar *
+j4status_colour_to_rgb(J4statusColour colour)
+{
+    if ( ! colour.set )
+        return NULL;
 
-    return nk_colour_to_rgba(&colour_);
+    return _j4status_colour_to_string(colour, TRUE);
 }
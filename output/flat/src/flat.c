@@ -41,11 +41,23 @@ struct _J4statusPluginContext {
     J4statusCoreInterface *core;
     gchar *label_separator;
     J4statusColour colours[_J4STATUS_STATE_SIZE];
+    ColourStr state_colours[_J4STATUS_STATE_SIZE][2]; /* [state][urgent] */
     gboolean back_colours;
     gboolean align;
     GString *line;
 };
 
+/*
+ * Compiled the first time we see a section,
+ * line always starts with the label and left padding
+ */
+typedef struct {
+    GString *line;
+    gsize prefix_length;
+    gchar *suffix;
+    gboolean empty;
+} J4statusFlatSection;
+
 struct _J4statusOutputPluginStream {
     J4statusPluginContext *context;
     J4statusCoreStream *stream;
@@ -127,6 +139,113 @@ _j4status_flat_set_colour(ColourStr *out, J4statusColour colour, J4statusColour
         out->end[0] = '\0';
 }
 
+static void
+_j4status_flat_section_free(gpointer data)
+{
+    J4statusFlatSection *self = data;
+
+    g_free(self->suffix);
+    g_string_free(self->line, TRUE);
+
+    g_slice_free(J4statusFlatSection, self);
+}
+
+static J4statusFlatSection *
+_j4status_flat_section_new(J4statusPluginContext *context, J4statusSection *section)
+{
+    J4statusFlatSection *self;
+
+    self = g_slice_new0(J4statusFlatSection);
+    self->line = g_string_new("");
+    self->empty = TRUE;
+
+    gsize l = 0, r = 0;
+
+    if ( context->align )
+    {
+        gint64 max_width;
+        max_width = j4status_section_get_max_width(section);
+
+        if ( max_width < 0 )
+        {
+            gsize s = -max_width;
+            switch ( j4status_section_get_align(section) )
+            {
+            case J4STATUS_ALIGN_CENTER:
+                l = s / 2;
+                r = ( s + 1 ) / 2;
+            break;
+            case J4STATUS_ALIGN_LEFT:
+                r = s;
+            break;
+            case J4STATUS_ALIGN_RIGHT:
+                l = s;
+            break;
+            }
+        }
+    }
+
+    const gchar *label;
+    label = j4status_section_get_label(section);
+    if ( label != NULL )
+    {
+        J4statusColour back_colour = {0};
+        COLOUR_STR(label_colour_str);
+        _j4status_flat_set_colour(&label_colour_str, j4status_section_get_label_colour(section), back_colour, FALSE);
+
+        g_string_append(self->line, label_colour_str.start);
+        g_string_append(self->line, label);
+        g_string_append(self->line, label_colour_str.end);
+        g_string_append(self->line, context->label_separator);
+    }
+    gchar *align_left;
+    align_left = g_strnfill(l, ' ');
+    g_string_append_len(self->line, align_left, l);
+    g_free(align_left);
+
+    self->prefix_length = self->line->len;
+    self->suffix = g_strnfill(r, ' ');
+
+    j4status_section_set_output_user_data(section, self, _j4status_flat_section_free);
+
+    return self;
+}
+
+static void
+_j4status_flat_section_update(J4statusPluginContext *context, J4statusFlatSection *self, J4statusSection *section)
+{
+    const gchar *value;
+    value = j4status_section_get_value(section);
+
+    /* We keep our own line, so we just need to clear the dirty flag */
+    j4status_section_set_cache(section, NULL);
+
+    self->empty = ( value == NULL );
+    if ( self->empty )
+        return;
+
+    J4statusState state = j4status_section_get_state(section);
+    gboolean urgent = ( state & J4STATUS_STATE_URGENT );
+    J4statusColour colour = j4status_section_get_colour(section);
+    J4statusColour back_colour = j4status_section_get_background_colour(section);
+
+    COLOUR_STR(forced_colour_str);
+    const ColourStr *colour_str;
+    if ( ( ! colour.set ) && ( ! back_colour.set ) )
+        colour_str = &context->state_colours[state & ~J4STATUS_STATE_FLAGS][urgent ? 1 : 0];
+    else
+    {
+        _j4status_flat_set_colour(&forced_colour_str, colour, back_colour, urgent);
+        colour_str = &forced_colour_str;
+    }
+
+    g_string_truncate(self->line, self->prefix_length);
+    g_string_append(self->line, colour_str->start);
+    g_string_append(self->line, value);
+    g_string_append(self->line, colour_str->end);
+    g_string_append(self->line, self->suffix);
+}
+
 static void
 _j4status_flat_generate_line(J4statusPluginContext *context, GList *sections)
 {
@@ -137,86 +256,19 @@ _j4status_flat_generate_line(J4statusPluginContext *context, GList *sections)
     for ( section_ = sections ; section_ != NULL ; section_ = g_list_next(section_) )
     {
         section = section_->data;
-        const gchar *cache;
+        J4statusFlatSection *flat_section;
+        flat_section = j4status_section_get_output_user_data(section);
+        if ( flat_section == NULL )
+            flat_section = _j4status_flat_section_new(context, section);
         if ( j4status_section_is_dirty(section) )
-        {
-            gchar *new_cache = NULL;
-            const gchar *value;
-            value = j4status_section_get_value(section);
-            if ( value != NULL )
-            {
-                J4statusColour colour = {0};
-                J4statusColour back_colour = {0};
-                COLOUR_STR(colour_str);
-
-
-                J4statusState state = j4status_section_get_state(section);
-                gboolean urgent = ( state & J4STATUS_STATE_URGENT );
-                colour = j4status_section_get_colour(section);
-                back_colour = j4status_section_get_background_colour(section);
-                if ( ( ! colour.set ) && ( ! back_colour.set ) )
-                {
-                    if ( context->back_colours )
-                        back_colour = context->colours[state & ~J4STATUS_STATE_FLAGS];
-                    else
-                        colour = context->colours[state & ~J4STATUS_STATE_FLAGS];
-                }
-                _j4status_flat_set_colour(&colour_str, colour, back_colour, urgent);
-
-                gsize s = 1, l = 0, r = 0;
-
-                if ( context->align )
-                {
-                    gint64 max_width;
-                    max_width = j4status_section_get_max_width(section);
-
-                    if ( max_width < 0 )
-                    {
-                        s = -max_width;
-                        switch ( j4status_section_get_align(section) )
-                        {
-                        case J4STATUS_ALIGN_CENTER:
-                            l = s / 2;
-                            r = ( s + 1 ) / 2;
-                        break;
-                        case J4STATUS_ALIGN_LEFT:
-                            r = s;
-                        break;
-                        case J4STATUS_ALIGN_RIGHT:
-                            l = s;
-                        break;
-                        }
-                    }
-                }
-                gchar align_left[s], align_right[s];
-                memset(align_left, ' ', l); align_left[l] = '\0';
-                memset(align_right, ' ', r); align_right[r] = '\0';
-
-                const gchar *label;
-                label = j4status_section_get_label(section);
-                if ( label != NULL )
-                {
-                    J4statusColour back_colour = {0};
-                    COLOUR_STR(label_colour_str);
-                    _j4status_flat_set_colour(&label_colour_str, j4status_section_get_label_colour(section), back_colour, FALSE);
-
-                    new_cache = g_strdup_printf("%s%s%s%s%s%s%s%s%s", label_colour_str.start, label, label_colour_str.end, context->label_separator, align_left, colour_str.start, value, colour_str.end, align_right);
-                }
-                else
-                    new_cache = g_strdup_printf("%s%s%s%s%s", align_left, colour_str.start, value, colour_str.end, align_right);
-            }
-            j4status_section_set_cache(section, new_cache);
-            cache = new_cache;
-        }
-        else
-            cache = j4status_section_get_cache(section);
-        if ( cache == NULL )
+            _j4status_flat_section_update(context, flat_section, section);
+        if ( flat_section->empty )
             continue;
         if ( first )
             first = FALSE;
         else
             g_string_append(context->line, " | ");
-        g_string_append(context->line, cache);
+        g_string_append_len(context->line, flat_section->line->str, flat_section->line->len);
     }
     g_string_append_c(context->line, '\n');
 }
@@ -290,6 +342,25 @@ _j4status_flat_init(J4statusCoreInterface *core)
     if ( key_file != NULL )
         g_key_file_free(key_file);
 
+    J4statusState state;
+    for ( state = 0 ; state < _J4STATUS_STATE_SIZE ; ++state )
+    {
+        J4statusColour colour = {0};
+        J4statusColour back_colour = {0};
+        if ( context->back_colours )
+            back_colour = context->colours[state];
+        else
+            colour = context->colours[state];
+
+        COLOUR_STR(colour_str);
+        _j4status_flat_set_colour(&colour_str, colour, back_colour, FALSE);
+        context->state_colours[state][0] = colour_str;
+
+        COLOUR_STR(urgent_colour_str);
+        _j4status_flat_set_colour(&urgent_colour_str, colour, back_colour, TRUE);
+        context->state_colours[state][1] = urgent_colour_str;
+    }
+
     context->line = g_string_new("");
 
     return context;
@@ -40,10 +40,26 @@ struct _J4statusPluginContext {
     J4statusCoreInterface *core;
     gchar *label_separator;
     J4statusColour colours[_J4STATUS_STATE_SIZE];
+    ColourStr state_colours[_J4STATUS_STATE_SIZE];
     gboolean align;
     GByteArray *line;
 };
 
+/*
+ * Compiled the first time we see a section,
+ * line always starts with the label and left padding
+ * The label span depends on the background colour,
+ * so a forced background colour means rebuilding the prefix
+ */
+typedef struct {
+    GString *line;
+    gsize prefix_length;
+    gboolean prefix_background;
+    gchar *align_left;
+    gchar *align_right;
+    gboolean empty;
+} J4statusPangoSection;
+
 struct _J4statusOutputPluginStream {
     J4statusPluginContext *context;
     J4statusCoreStream *stream;
@@ -135,6 +151,124 @@ _j4status_pango_set_colour(ColourStr *out, J4statusColour colour, J4statusColour
     g_snprintf(out->start + o, l - o, ">");
 }
 
+static void
+_j4status_pango_section_free(gpointer data)
+{
+    J4statusPangoSection *self = data;
+
+    g_free(self->align_right);
+    g_free(self->align_left);
+    g_string_free(self->line, TRUE);
+
+    g_slice_free(J4statusPangoSection, self);
+}
+
+static void
+_j4status_pango_section_build_prefix(J4statusPluginContext *context, J4statusPangoSection *self, J4statusSection *section, J4statusColour back_colour)
+{
+    g_string_truncate(self->line, 0);
+
+    const gchar *label;
+    label = j4status_section_get_label(section);
+    if ( label != NULL )
+    {
+        COLOUR_STR(label_colour_str);
+        _j4status_pango_set_colour(&label_colour_str, j4status_section_get_label_colour(section), back_colour);
+
+        g_string_append(self->line, label_colour_str.start);
+        j4status_escape_markup_append(self->line, label, -1);
+        g_string_append(self->line, label_colour_str.end);
+        g_string_append(self->line, context->label_separator);
+    }
+    g_string_append(self->line, self->align_left);
+
+    self->prefix_length = self->line->len;
+    self->prefix_background = back_colour.set;
+}
+
+static J4statusPangoSection *
+_j4status_pango_section_new(J4statusPluginContext *context, J4statusSection *section)
+{
+    J4statusPangoSection *self;
+
+    self = g_slice_new0(J4statusPangoSection);
+    self->line = g_string_new("");
+    self->empty = TRUE;
+
+    gsize l = 0, r = 0;
+
+    if ( context->align )
+    {
+        gint64 max_width;
+        max_width = j4status_section_get_max_width(section);
+
+        if ( max_width < 0 )
+        {
+            gsize s = -max_width;
+            switch ( j4status_section_get_align(section) )
+            {
+            case J4STATUS_ALIGN_CENTER:
+                l = s / 2;
+                r = ( s + 1 ) / 2;
+            break;
+            case J4STATUS_ALIGN_LEFT:
+                r = s;
+            break;
+            case J4STATUS_ALIGN_RIGHT:
+                l = s;
+            break;
+            }
+        }
+    }
+    self->align_left = g_strnfill(l, ' ');
+    self->align_right = g_strnfill(r, ' ');
+
+    J4statusColour back_colour = {0};
+    _j4status_pango_section_build_prefix(context, self, section, back_colour);
+
+    j4status_section_set_output_user_data(section, self, _j4status_pango_section_free);
+
+    return self;
+}
+
+static void
+_j4status_pango_section_update(J4statusPluginContext *context, J4statusPangoSection *self, J4statusSection *section)
+{
+    const gchar *value;
+    value = j4status_section_get_value(section);
+
+    /* We keep our own line, so we just need to clear the dirty flag */
+    j4status_section_set_cache(section, NULL);
+
+    self->empty = ( value == NULL );
+    if ( self->empty )
+        return;
+
+    J4statusState state = j4status_section_get_state(section);
+    J4statusColour colour = j4status_section_get_colour(section);
+    J4statusColour back_colour = j4status_section_get_background_colour(section);
+
+    COLOUR_STR(forced_colour_str);
+    const ColourStr *colour_str;
+    if ( ( ! colour.set ) && ( ! back_colour.set ) )
+        colour_str = &context->state_colours[state & ~J4STATUS_STATE_FLAGS];
+    else
+    {
+        _j4status_pango_set_colour(&forced_colour_str, colour, back_colour);
+        colour_str = &forced_colour_str;
+    }
+
+    if ( back_colour.set || self->prefix_background )
+        _j4status_pango_section_build_prefix(context, self, section, back_colour);
+    else
+        g_string_truncate(self->line, self->prefix_length);
+
+    g_string_append(self->line, colour_str->start);
+    j4status_escape_markup_append(self->line, value, -1);
+    g_string_append(self->line, colour_str->end);
+    g_string_append(self->line, self->align_right);
+}
+
 #define byte_append(b) G_STMT_START { guint8 b_ = (b); g_byte_array_append(context->line, &b_, 1); } G_STMT_END
 static void
 _j4status_pango_generate_line(J4statusPluginContext *context, GList *sections)
@@ -146,82 +280,24 @@ _j4status_pango_generate_line(J4statusPluginContext *context, GList *sections)
     for ( section_ = sections ; section_ != NULL ; section_ = g_list_next(section_) )
     {
         section = section_->data;
-        const gchar *cache;
+        J4statusPangoSection *pango_section;
+        pango_section = j4status_section_get_output_user_data(section);
+        if ( pango_section == NULL )
+            pango_section = _j4status_pango_section_new(context, section);
         if ( j4status_section_is_dirty(section) )
         {
-            gchar *new_cache = NULL;
-            const gchar *value;
-            value = j4status_section_get_value(section);
-            if ( value != NULL )
-            {
-                J4statusColour colour = {0};
-                J4statusColour back_colour = {0};
-                COLOUR_STR(colour_str);
-
-
-                J4statusState state = j4status_section_get_state(section);
-                urgent = urgent || ( state & J4STATUS_STATE_URGENT );
-                colour = j4status_section_get_colour(section);
-                back_colour = j4status_section_get_background_colour(section);
-                if ( ( ! colour.set ) && ( ! back_colour.set ) )
-                    colour = context->colours[state & ~J4STATUS_STATE_FLAGS];
-                _j4status_pango_set_colour(&colour_str, colour, back_colour);
-
-                gsize s = 1, l = 0, r = 0;
-
-                if ( context->align )
-                {
-                    gint64 max_width;
-                    max_width = j4status_section_get_max_width(section);
-
-                    if ( max_width < 0 )
-                    {
-                        s = -max_width;
-                        switch ( j4status_section_get_align(section) )
-                        {
-                        case J4STATUS_ALIGN_CENTER:
-                            l = s / 2;
-                            r = ( s + 1 ) / 2;
-                        break;
-                        case J4STATUS_ALIGN_LEFT:
-                            r = s;
-                        break;
-                        case J4STATUS_ALIGN_RIGHT:
-                            l = s;
-                        break;
-                        }
-                    }
-                }
-                gchar align_left[s], align_right[s];
-                memset(align_left, ' ', l); align_left[l] = '\0';
-                memset(align_right, ' ', r); align_right[r] = '\0';
-
-                const gchar *label;
-                label = j4status_section_get_label(section);
-                if ( label != NULL )
-                {
-                    COLOUR_STR(label_colour_str);
-                    _j4status_pango_set_colour(&label_colour_str, j4status_section_get_label_colour(section), back_colour);
-
-                    new_cache = g_strdup_printf("%s%s%s%s%s%s%s%s%s", label_colour_str.start, label, label_colour_str.end, context->label_separator, align_left, colour_str.start, value, colour_str.end, align_right);
-                }
-                else
-                    new_cache = g_strdup_printf("%s%s%s%s%s", align_left, colour_str.start, value, colour_str.end, align_right);
-            }
-            j4status_section_set_cache(section, new_cache);
-            cache = new_cache;
+            _j4status_pango_section_update(context, pango_section, section);
+            urgent = urgent || ( ( ! pango_section->empty ) && ( j4status_section_get_state(section) & J4STATUS_STATE_URGENT ) );
         }
-        else
-            cache = j4status_section_get_cache(section);
-        if ( cache == NULL )
+        if ( pango_section->empty )
             continue;
 
         guint64 length, size;
-        length = strlen(cache);
+        length = pango_section->line->len;
         size = GUINT64_TO_BE(length);
         byte_append('s');
         g_byte_array_append(context->line, (const guint8 *) &size, sizeof(size));
-        g_byte_array_append(context->line, (const guint8 *) cache, length);
+        g_byte_array_append(context->line, (const guint8 *) pango_section->line->str, length);
 
     }
     if ( urgent )
@@ -285,6 +361,15 @@ _j4status_pango_init(J4statusCoreInterface *core)
     if ( key_file != NULL )
         g_key_file_free(key_file);
 
+    J4statusState state;
+    for ( state = 0 ; state < _J4STATUS_STATE_SIZE ; ++state )
+    {
+        J4statusColour back_colour = {0};
+        COLOUR_STR(colour_str);
+        _j4status_pango_set_colour(&colour_str, context->colours[state], back_colour);
+        context->state_colours[state] = colour_str;
+    }
+
     context->line = g_byte_array_new();
 
     return context;